@@ -0,0 +1,278 @@
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <optional>
+#include "common_header_file.h"
+#include "reclamation.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "bench.h"
+
+using namespace std;
+
+// Cells per segment of the FAA array queue.
+#define FAA_SEGMENT_SIZE 1024
+
+// Queue of linked array segments in the style of the FAA array queue (the LCRQ family).
+// Enqueuers and dequeuers claim a cell of the tail / head segment with one fetch_add on its
+// index and then only touch that cell, so an operation costs one FAA and one CAS/exchange on
+// a private cell instead of two CAS on the shared tail or head. A new segment is allocated
+// and linked only when the tail segment is used up.
+// A dequeuer that claims a cell before its enqueuer marks it taken; the enqueuer then fails
+// its CAS on the cell and moves its value on to the next cell.
+// Segments hold Size cells.
+template<class T, class Reclaim = hp_reclaim, int Size = FAA_SEGMENT_SIZE>
+class faaqueue {
+    typedef enum {
+        CELL_EMPTY = 0,
+        CELL_FULL,
+        CELL_TAKEN
+    } cell_state;
+
+    class cell {
+    public:
+        atomic<uint32_t> state{CELL_EMPTY};
+        value_cell<T> val;
+    };
+
+    class segment : public pooled<segment> {
+    public:
+        alignas(CACHE_LINE_SIZE) atomic<long> enq_idx{0};
+        alignas(CACHE_LINE_SIZE) atomic<long> deq_idx{0};
+        alignas(CACHE_LINE_SIZE) atomic<segment*> next{nullptr};
+        cell cells[Size];
+    };
+
+private:
+    alignas(CACHE_LINE_SIZE) atomic<segment*> head;
+    alignas(CACHE_LINE_SIZE) atomic<segment*> tail;
+
+public:
+    faaqueue();
+    ~faaqueue();
+    // Constructs the value in place inside the claimed cell
+    template<class... Args>
+    void emplace(Args&&... args);
+    void enqueue(const T& val) { emplace(val); }
+    void enqueue(T&& val) { emplace(move(val)); }
+    // Moves the front value out, nullopt when the queue is empty
+    optional<T> dequeue();
+    // Prefills the segment arena so the first n enqueues do not allocate from malloc
+    void reserve(size_t n) { node_pool<segment>::instance().reserve(n / Size + 1); }
+};
+
+template<class T, class Reclaim, int Size>
+faaqueue<T, Reclaim, Size>::faaqueue() {
+    segment* s = new segment();
+    head.store(s);
+    tail.store(s);
+}
+
+template<class T, class Reclaim, int Size>
+faaqueue<T, Reclaim, Size>::~faaqueue() {
+    segment* s = head.load(memory_order_acquire);
+    while (s != nullptr) {
+        segment* next = s->next.load(memory_order_relaxed);
+        for (auto& c : s->cells) {
+            if (c.state.load(memory_order_relaxed) == CELL_FULL)
+                c.val.destroy();
+        }
+        delete s;
+        s = next;
+    }
+}
+
+template<class T, class Reclaim, int Size>
+template<class... Args>
+void faaqueue<T, Reclaim, Size>::emplace(Args&&... args) {
+    typename Reclaim::guard g;
+    // Value taken back from a cell a dequeuer gave up on
+    optional<T> pending;
+    while (true) {
+        segment* s = g.protect(0, tail);
+        long idx = s->enq_idx.fetch_add(1, memory_order_acq_rel);
+        if (idx >= Size) {
+            // Segment used up: link a new one or help the enqueuer that did
+            if (s != tail.load(memory_order_acquire))
+                continue;
+            segment* next = s->next.load(memory_order_acquire);
+            if (next == nullptr) {
+                segment* n = new segment();
+                if (s->next.compare_exchange_strong(next, n, memory_order_acq_rel))
+                    next = n;
+                else
+                    delete n; // Never visible to other threads
+            }
+            tail.compare_exchange_strong(s, next, memory_order_acq_rel);
+            continue;
+        }
+
+        cell& c = s->cells[idx];
+        if (pending)
+            c.val.construct(move(*pending));
+        else
+            c.val.construct(forward<Args>(args)...);
+
+        uint32_t expected = CELL_EMPTY;
+        if (c.state.compare_exchange_strong(expected, CELL_FULL, memory_order_acq_rel)) // linearization point
+            return;
+
+        // A dequeuer gave up on this cell. Nobody reads it, the value moves on with the next
+        // claim; it is taken out now as the segment is no longer protected after this round.
+        pending.reset();
+        pending.emplace(c.val.take());
+    }
+}
+
+template<class T, class Reclaim, int Size>
+optional<T> faaqueue<T, Reclaim, Size>::dequeue() {
+    typename Reclaim::guard g;
+    while (true) {
+        segment* s = g.protect(0, head);
+        if (s->deq_idx.load(memory_order_acquire) >= s->enq_idx.load(memory_order_acquire) &&
+            s->next.load(memory_order_acquire) == nullptr)
+            return nullopt; // Queue is empty
+
+        long idx = s->deq_idx.fetch_add(1, memory_order_acq_rel);
+        if (idx >= Size) {
+            // Segment drained: move head on and retire it, enqueuers may still hold it.
+            // tail may still point to it when its enqueuer has not moved tail on yet, so
+            // help with that first, no enqueuer can reach the segment once it is retired.
+            segment* next = s->next.load(memory_order_acquire);
+            if (next == nullptr)
+                return nullopt;
+            segment* t = s;
+            tail.compare_exchange_strong(t, next, memory_order_acq_rel);
+            if (head.compare_exchange_strong(s, next, memory_order_acq_rel)) {
+                g.clear(0);
+                Reclaim::retire(s);
+            }
+            continue;
+        }
+
+        cell& c = s->cells[idx];
+        if (c.state.exchange(CELL_TAKEN, memory_order_acq_rel) == CELL_FULL) { // linearization point
+            optional<T> v;
+            c.val.move_to(v);
+            return v;
+        }
+        // Got here before the enqueuer, which will retry elsewhere
+    }
+}
+
+// This test is designed in such a way that multiple threads will execute the queue methods and
+// it is possible that for example during enqueue the sequence can be mistmatched with the values enqueued as in real time
+// threads can be executed in interleaved manner. So, to test, summing up the values enqueued should be equal to the sum of the values dequeued.
+
+template<class Queue>
+static int faaqueue_test_run(int num_threads, vector<int>& arr) {
+    int num_thread_for_each_ops = (num_threads / 2);
+
+    // Atomic counters for tracking
+    atomic<int> enqueue_counter(0);
+    atomic<int> dequeue_counter(0);
+
+    // Total sum tracking
+    atomic<long> sum(0);
+    long sum_actual = 0;
+
+    Queue myqueue;
+    myqueue.reserve(num_thread_for_each_ops * arr.size());
+    vector<thread> local_threads;
+
+    // enqueue threads
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                myqueue.enqueue(arr[j]);
+                enqueue_counter.fetch_add(1, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // dequeue threads, retrying while the queue is empty
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                optional<int> value;
+                while (!(value = myqueue.dequeue()))
+                    this_thread::yield();
+                dequeue_counter.fetch_add(1, memory_order_seq_cst);
+                sum.fetch_add(*value, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // Wait for all threads
+    for (auto& t : local_threads) {
+        t.join();
+    }
+
+    // Calculate expected sum
+    for (size_t j = 0; j < arr.size(); j++) {
+        sum_actual += arr[j] * num_thread_for_each_ops;
+    }
+
+    // Verification checks
+
+    // 1. Check if final Queue is empty
+    if (myqueue.dequeue()) {
+        cout << "Queue should be empty at this point" << endl;
+        return -1;
+    }
+
+    // 2. Verify enqueue and dequeue counts
+    int expected_total_ops = num_thread_for_each_ops * arr.size();
+    int actual_enqueue_count = enqueue_counter.load(memory_order_seq_cst);
+    int actual_dequeue_count = dequeue_counter.load(memory_order_seq_cst);
+
+    cout << "Expected total operations: " << expected_total_ops << endl;
+    cout << "Actual enqueue count: " << actual_enqueue_count << endl;
+    cout << "Actual dequeue count: " << actual_dequeue_count << endl;
+
+    if (actual_enqueue_count != expected_total_ops) {
+        cout << "Enqueue count mismatch" << endl;
+        return -1;
+    }
+
+    if (actual_dequeue_count != expected_total_ops) {
+        cout << "Dequeue count mismatch" << endl;
+        return -1;
+    }
+
+    // 3. Verify sum
+    if (sum_actual != sum.load(memory_order_seq_cst)) {
+        cout << "Sum mismatch" << endl;
+        return -1;
+    }
+
+    cout << "Peak RSS: " << peak_rss_kb() << " KB" << endl;
+    cout << "Test passed successfully" << endl;
+    return 0;
+}
+
+// Runs the test on the queue, then again with at least 8 threads on segments of two cells:
+// every second enqueue links a segment, so tail often still points to a segment that the
+// dequeuers have drained and retire
+int faaqueue_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim) {
+    return with_reclaim(reclaim, [&]<class Reclaim>() {
+        if (faaqueue_test_run<faaqueue<int, Reclaim>>(num_threads, arr) != 0)
+            return -1;
+        cout << "Stress test with segments of 2 cells" << endl;
+        return faaqueue_test_run<faaqueue<int, Reclaim, 2>>(max(num_threads, 8), arr);
+    });
+}
+
+// One row of the reclamation benchmark: throughput and peak RSS for the given scheme
+int faaqueue_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim) {
+    double ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        faaqueue<int, Reclaim> myqueue;
+        return run_throughput(num_threads, arr, iters,
+                              [&](int v) { myqueue.enqueue(v); },
+                              [&]() { return myqueue.dequeue().has_value(); });
+    });
+    cout << "| FAA_QUEUE | " << reclaim_name(reclaim) << " | " << num_threads << " | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <optional>
+#include "common_header_file.h"
+#include "reclamation.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "bench.h"
+
+using namespace std;
+
+// Wait-free queue of Kogan and Petrank, built on the Michael and Scott Queue.
+// Every operation first announces itself in state[tid] with a phase number larger than all
+// announced ones, then helps every pending operation with a phase up to its own before
+// returning. An operation can therefore only be overtaken by operations that started
+// before it, which bounds its steps by O(threads^2) whatever the other threads do.
+// Descriptors are immutable and replaced by CAS; replaced descriptors and unlinked nodes
+// are retired to the epoch scheme. Epochs keep everything a helper reached alive for the
+// whole operation, which the helping protocol needs (hazard pointers would have to
+// protect an unbounded set of descriptors); reclamation itself is not wait-free.
+template<class T>
+class kpqueue {
+    class node : public pooled<node> {
+    public:
+        value_cell<T> val;
+        atomic<node*> next{nullptr};
+        int enq_tid;
+        atomic<int> deq_tid{-1};
+
+        node() : enq_tid(-1) {}
+        template<class... Args>
+        node(int tid, Args&&... args) : enq_tid(tid) { val.construct(forward<Args>(args)...); }
+    };
+
+    class op_desc : public pooled<op_desc> {
+    public:
+        long phase;
+        bool pending;
+        bool enqueue;
+        node* n;
+
+        op_desc(long ph, bool pend, bool enq, node* nd) : phase(ph), pending(pend), enqueue(enq), n(nd) {}
+    };
+
+private:
+    alignas(CACHE_LINE_SIZE) atomic<node*> head;
+    alignas(CACHE_LINE_SIZE) atomic<node*> tail;
+    vector<atomic<op_desc*>> state;
+
+    long max_phase();
+    bool is_still_pending(int tid, long phase);
+    // Replaces cur by desc in state[tid], retires the loser's garbage
+    void replace_state(int tid, op_desc* cur, op_desc* desc);
+    void help(long phase);
+    void help_enq(int tid, long phase);
+    void help_finish_enq();
+    void help_deq(int tid, long phase);
+    void help_finish_deq();
+
+public:
+    // Thread ids passed to the operations must be below num_threads
+    kpqueue(int num_threads);
+    ~kpqueue();
+    template<class... Args>
+    void emplace(int tid, Args&&... args);
+    void enqueue(int tid, const T& val) { emplace(tid, val); }
+    void enqueue(int tid, T&& val) { emplace(tid, move(val)); }
+    // Moves the front value out, nullopt when the queue is empty
+    optional<T> dequeue(int tid);
+    // Prefills the node arena so the first n enqueues do not allocate from malloc
+    void reserve(size_t n) { node_pool<node>::instance().reserve(n); }
+};
+
+template<class T>
+kpqueue<T>::kpqueue(int num_threads) : state(num_threads) {
+    node* sentinel = new node();
+    head.store(sentinel);
+    tail.store(sentinel);
+    for (auto& s : state)
+        s.store(new op_desc(-1, false, true, nullptr));
+}
+
+template<class T>
+kpqueue<T>::~kpqueue() {
+    node* n = head.load(memory_order_acquire);
+    bool is_dummy = true;
+    while (n != nullptr) {
+        node* next = n->next.load(memory_order_relaxed);
+        if (!is_dummy)
+            n->val.destroy();
+        delete n;
+        n = next;
+        is_dummy = false;
+    }
+    for (auto& s : state)
+        delete s.load();
+}
+
+template<class T>
+long kpqueue<T>::max_phase() {
+    long m = -1;
+    for (auto& s : state)
+        m = max(m, s.load(memory_order_acquire)->phase);
+    return m;
+}
+
+template<class T>
+bool kpqueue<T>::is_still_pending(int tid, long phase) {
+    op_desc* d = state[tid].load(memory_order_acquire);
+    return d->pending && d->phase <= phase;
+}
+
+template<class T>
+void kpqueue<T>::replace_state(int tid, op_desc* cur, op_desc* desc) {
+    if (state[tid].compare_exchange_strong(cur, desc, memory_order_acq_rel))
+        ebr_reclaim::retire(cur);
+    else
+        delete desc; // Never published
+}
+
+template<class T>
+void kpqueue<T>::help(long phase) {
+    for (size_t i = 0; i < state.size(); i++) {
+        op_desc* d = state[i].load(memory_order_acquire);
+        if (d->pending && d->phase <= phase) {
+            if (d->enqueue)
+                help_enq(i, phase);
+            else
+                help_deq(i, phase);
+        }
+    }
+}
+
+template<class T>
+template<class... Args>
+void kpqueue<T>::emplace(int tid, Args&&... args) {
+    ebr_reclaim::guard g;
+    long phase = max_phase() + 1;
+    node* n = new node(tid, forward<Args>(args)...);
+    ebr_reclaim::retire(state[tid].exchange(new op_desc(phase, true, true, n), memory_order_acq_rel));
+    help(phase);
+    help_finish_enq();
+}
+
+template<class T>
+void kpqueue<T>::help_enq(int tid, long phase) {
+    while (is_still_pending(tid, phase)) {
+        node* last = tail.load(memory_order_acquire);
+        node* next = last->next.load(memory_order_acquire);
+        if (last != tail.load(memory_order_acquire))
+            continue;
+        if (next == nullptr) {
+            if (is_still_pending(tid, phase)) {
+                node* n = state[tid].load(memory_order_acquire)->n;
+                if (last->next.compare_exchange_strong(next, n, memory_order_acq_rel)) { // linearization point
+                    help_finish_enq();
+                    return;
+                }
+            }
+        }
+        else
+            help_finish_enq(); // Another enqueue is half done
+    }
+}
+
+template<class T>
+void kpqueue<T>::help_finish_enq() {
+    node* last = tail.load(memory_order_acquire);
+    node* next = last->next.load(memory_order_acquire);
+    if (next == nullptr)
+        return;
+
+    // Mark the enqueue of next as done before tail moves past it
+    int tid = next->enq_tid;
+    op_desc* cur = state[tid].load(memory_order_acquire);
+    if (last == tail.load(memory_order_acquire) && cur->enqueue && cur->n == next)
+        replace_state(tid, cur, new op_desc(cur->phase, false, true, next));
+    tail.compare_exchange_strong(last, next, memory_order_acq_rel);
+}
+
+template<class T>
+optional<T> kpqueue<T>::dequeue(int tid) {
+    ebr_reclaim::guard g;
+    long phase = max_phase() + 1;
+    ebr_reclaim::retire(state[tid].exchange(new op_desc(phase, true, false, nullptr), memory_order_acq_rel));
+    help(phase);
+    help_finish_deq();
+
+    // The op ends with the old dummy in the descriptor, the value is in the node after it
+    node* n = state[tid].load(memory_order_acquire)->n;
+    if (n == nullptr)
+        return nullopt;
+    optional<T> v;
+    n->next.load(memory_order_acquire)->val.move_to(v);
+    return v;
+}
+
+template<class T>
+void kpqueue<T>::help_deq(int tid, long phase) {
+    while (is_still_pending(tid, phase)) {
+        node* first = head.load(memory_order_acquire);
+        node* last = tail.load(memory_order_acquire);
+        node* next = first->next.load(memory_order_acquire);
+        if (first != head.load(memory_order_acquire))
+            continue;
+
+        if (first == last) {
+            if (next == nullptr) {
+                // Queue is empty, complete the dequeue with no node
+                op_desc* cur = state[tid].load(memory_order_acquire);
+                if (last == tail.load(memory_order_acquire) && is_still_pending(tid, phase))
+                    replace_state(tid, cur, new op_desc(cur->phase, false, false, nullptr));
+            }
+            else
+                help_finish_enq(); // Tail is lagging behind
+        }
+        else {
+            op_desc* cur = state[tid].load(memory_order_acquire);
+            node* n = cur->n;
+            if (!is_still_pending(tid, phase))
+                break;
+            if (first == head.load(memory_order_acquire) && n != first) {
+                // Record the head this dequeue is going to take
+                op_desc* desc = new op_desc(cur->phase, true, false, first);
+                op_desc* expected = cur;
+                if (!state[tid].compare_exchange_strong(expected, desc, memory_order_acq_rel)) {
+                    delete desc;
+                    continue;
+                }
+                ebr_reclaim::retire(cur);
+            }
+            int none = -1;
+            first->deq_tid.compare_exchange_strong(none, tid, memory_order_acq_rel); // linearization point
+            help_finish_deq();
+        }
+    }
+}
+
+template<class T>
+void kpqueue<T>::help_finish_deq() {
+    node* first = head.load(memory_order_acquire);
+    node* next = first->next.load(memory_order_acquire);
+    int tid = first->deq_tid.load(memory_order_acquire);
+    if (tid == -1)
+        return;
+
+    op_desc* cur = state[tid].load(memory_order_acquire);
+    if (first == head.load(memory_order_acquire) && next != nullptr) {
+        replace_state(tid, cur, new op_desc(cur->phase, false, false, cur->n));
+        if (head.compare_exchange_strong(first, next, memory_order_acq_rel))
+            ebr_reclaim::retire(first);
+    }
+}
+
+// This test is designed in such a way that multiple threads will execute the queue methods and
+// it is possible that for example during enqueue the sequence can be mistmatched with the values enqueued as in real time
+// threads can be executed in interleaved manner. So, to test, summing up the values enqueued should be equal to the sum of the values dequeued.
+
+int kpqueue_test_advanced(int num_threads, vector<int>& arr) {
+    int num_thread_for_each_ops = (num_threads / 2);
+
+    // Atomic counters for tracking
+    atomic<int> enqueue_counter(0);
+    atomic<int> dequeue_counter(0);
+
+    // Total sum tracking
+    atomic<long> sum(0);
+    long sum_actual = 0;
+
+    // One extra id for the emptiness check below
+    kpqueue<int> myqueue(2 * num_thread_for_each_ops + 1);
+    myqueue.reserve(num_thread_for_each_ops * arr.size());
+    vector<thread> local_threads;
+
+    // enqueue threads
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&, i]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                myqueue.enqueue(i, arr[j]);
+                enqueue_counter.fetch_add(1, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // dequeue threads, retrying while the queue is empty
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&, i]() {
+            int tid = num_thread_for_each_ops + i;
+            for (size_t j = 0; j < arr.size(); j++) {
+                optional<int> value;
+                while (!(value = myqueue.dequeue(tid)))
+                    this_thread::yield();
+                dequeue_counter.fetch_add(1, memory_order_seq_cst);
+                sum.fetch_add(*value, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // Wait for all threads
+    for (auto& t : local_threads) {
+        t.join();
+    }
+
+    // Calculate expected sum
+    for (size_t j = 0; j < arr.size(); j++) {
+        sum_actual += arr[j] * num_thread_for_each_ops;
+    }
+
+    // Verification checks
+
+    // 1. Check if final Queue is empty
+    if (myqueue.dequeue(2 * num_thread_for_each_ops)) {
+        cout << "Queue should be empty at this point" << endl;
+        return -1;
+    }
+
+    // 2. Verify enqueue and dequeue counts
+    int expected_total_ops = num_thread_for_each_ops * arr.size();
+    int actual_enqueue_count = enqueue_counter.load(memory_order_seq_cst);
+    int actual_dequeue_count = dequeue_counter.load(memory_order_seq_cst);
+
+    cout << "Expected total operations: " << expected_total_ops << endl;
+    cout << "Actual enqueue count: " << actual_enqueue_count << endl;
+    cout << "Actual dequeue count: " << actual_dequeue_count << endl;
+
+    if (actual_enqueue_count != expected_total_ops) {
+        cout << "Enqueue count mismatch" << endl;
+        return -1;
+    }
+
+    if (actual_dequeue_count != expected_total_ops) {
+        cout << "Dequeue count mismatch" << endl;
+        return -1;
+    }
+
+    // 3. Verify sum
+    if (sum_actual != sum.load(memory_order_seq_cst)) {
+        cout << "Sum mismatch" << endl;
+        return -1;
+    }
+
+    cout << "Peak RSS: " << peak_rss_kb() << " KB" << endl;
+    cout << "Test passed successfully" << endl;
+    return 0;
+}
+
+// One row of the latency benchmark
+int kpqueue_latency_bench(int num_threads, vector<int>& arr, int iters) {
+    kpqueue<int> myqueue(2 * max(num_threads / 2, 1));
+    latency_stats l = run_latency(num_threads, arr, iters,
+                                  [&](int tid, int v) { myqueue.enqueue(tid, v); },
+                                  [&](int tid) { return myqueue.dequeue(tid).has_value(); });
+    cout << "| KP_QUEUE | " << num_threads << " | " << l.p50 << " | " << l.p99 << " | "
+         << l.p999 << " | " << l.max << " |" << endl;
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <optional>
+#include <cstdint>
+#include "common_header_file.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "bench.h"
+
+using namespace std;
+
+// Bounded multi producer multi consumer queue over a power of two ring (Vyukov).
+// Every cell carries a sequence number: seq == pos means the cell is free for the enqueue
+// of ticket pos, seq == pos + 1 means it holds the value for the dequeue of ticket pos.
+// A producer or consumer claims its ticket with one CAS on the shared position and then
+// only touches its own cell. Nothing is allocated after construction: a full ring makes
+// try_enqueue fail instead of growing, which is the backpressure on the producers.
+template<class T>
+class mpmc_ring {
+    // One cell per cache line, neighbouring tickets do not share a line
+    class alignas(CACHE_LINE_SIZE) cell {
+    public:
+        atomic<size_t> seq;
+        value_cell<T> val;
+    };
+
+private:
+    vector<cell> cells;
+    size_t mask;
+    alignas(CACHE_LINE_SIZE) atomic<size_t> enqueue_pos{0};
+    alignas(CACHE_LINE_SIZE) atomic<size_t> dequeue_pos{0};
+
+public:
+    // capacity is rounded up to a power of two
+    mpmc_ring(size_t capacity);
+    ~mpmc_ring();
+    size_t capacity() const { return mask + 1; }
+    // Constructs the value in place, false when the ring is full
+    template<class... Args>
+    bool try_emplace(Args&&... args);
+    bool try_enqueue(const T& val) { return try_emplace(val); }
+    bool try_enqueue(T&& val) { return try_emplace(move(val)); }
+    // Moves the front value out, nullopt when the ring is empty
+    optional<T> try_dequeue();
+};
+
+template<class T>
+mpmc_ring<T>::mpmc_ring(size_t capacity) : cells(round_up_pow2(capacity)), mask(cells.size() - 1) {
+    for (size_t i = 0; i < cells.size(); i++)
+        cells[i].seq.store(i, memory_order_relaxed);
+}
+
+template<class T>
+mpmc_ring<T>::~mpmc_ring() {
+    size_t end = enqueue_pos.load(memory_order_relaxed);
+    for (size_t pos = dequeue_pos.load(memory_order_relaxed); pos != end; pos++) {
+        cell& c = cells[pos & mask];
+        if (c.seq.load(memory_order_relaxed) == pos + 1)
+            c.val.destroy();
+    }
+}
+
+template<class T>
+template<class... Args>
+bool mpmc_ring<T>::try_emplace(Args&&... args) {
+    size_t pos = enqueue_pos.load(memory_order_relaxed);
+    cell* c;
+    while (true) {
+        c = &cells[pos & mask];
+        size_t seq = c->seq.load(memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return false; // The cell still holds the value of the previous lap: full
+        else
+            pos = enqueue_pos.load(memory_order_relaxed);
+    }
+    c->val.construct(forward<Args>(args)...);
+    c->seq.store(pos + 1, memory_order_release); // linearization point
+    return true;
+}
+
+template<class T>
+optional<T> mpmc_ring<T>::try_dequeue() {
+    size_t pos = dequeue_pos.load(memory_order_relaxed);
+    cell* c;
+    while (true) {
+        c = &cells[pos & mask];
+        size_t seq = c->seq.load(memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return nullopt; // The cell is not written yet: empty
+        else
+            pos = dequeue_pos.load(memory_order_relaxed);
+    }
+    optional<T> v;
+    c->val.move_to(v);
+    c->seq.store(pos + mask + 1, memory_order_release); // Free for the enqueue one lap later
+    return v;
+}
+
+int mpmc_ring_test_basic(size_t capacity) {
+    mpmc_ring<int> myring(capacity);
+
+    // Fill the ring, the next enqueue must report full
+    for (size_t i = 0; i < myring.capacity(); i++) {
+        if (!myring.try_enqueue(i)) {
+            cout << "The ring reported full before reaching its capacity" << endl;
+            return -1;
+        }
+    }
+    if (myring.try_enqueue(-1)) {
+        cout << "should have returned false as the ring should be full at this point" << endl;
+        return -1;
+    }
+
+    for (size_t i = 0; i < myring.capacity(); i++) {
+        if (myring.try_dequeue() != (int)i) {
+            cout << "The ring is not behaving properly and there is some issue" << endl;
+            return -1;
+        }
+    }
+    if (myring.try_dequeue()) {
+        cout << "should have returned nullopt as ring should be empty at this point" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Producers retry while the ring is full and consumers while it is empty, so with a small
+// capacity the producers are throttled to the speed of the consumers.
+int mpmc_ring_test_advanced(int num_threads, vector<int>& arr, size_t capacity) {
+    if (mpmc_ring_test_basic(capacity) != 0)
+        return -1;
+
+    int num_thread_for_each_ops = (num_threads / 2);
+
+    // Atomic counters for tracking
+    atomic<int> enqueue_counter(0);
+    atomic<int> dequeue_counter(0);
+    atomic<long> full_counter(0);
+
+    // Total sum tracking
+    atomic<long> sum(0);
+    long sum_actual = 0;
+
+    mpmc_ring<int> myring(capacity);
+    vector<thread> local_threads;
+
+    // enqueue threads
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                while (!myring.try_enqueue(arr[j])) {
+                    full_counter.fetch_add(1, memory_order_relaxed);
+                    this_thread::yield();
+                }
+                enqueue_counter.fetch_add(1, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // dequeue threads
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                optional<int> value;
+                while (!(value = myring.try_dequeue()))
+                    this_thread::yield();
+                dequeue_counter.fetch_add(1, memory_order_seq_cst);
+                sum.fetch_add(*value, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // Wait for all threads
+    for (auto& t : local_threads) {
+        t.join();
+    }
+
+    // Calculate expected sum
+    for (size_t j = 0; j < arr.size(); j++) {
+        sum_actual += arr[j] * num_thread_for_each_ops;
+    }
+
+    // Verification checks
+
+    // 1. Check if final ring is empty
+    if (myring.try_dequeue()) {
+        cout << "Ring should be empty at this point" << endl;
+        return -1;
+    }
+
+    // 2. Verify enqueue and dequeue counts
+    int expected_total_ops = num_thread_for_each_ops * arr.size();
+    int actual_enqueue_count = enqueue_counter.load(memory_order_seq_cst);
+    int actual_dequeue_count = dequeue_counter.load(memory_order_seq_cst);
+
+    cout << "Capacity: " << myring.capacity() << endl;
+    cout << "Expected total operations: " << expected_total_ops << endl;
+    cout << "Actual enqueue count: " << actual_enqueue_count << endl;
+    cout << "Actual dequeue count: " << actual_dequeue_count << endl;
+    cout << "Enqueues rejected as full: " << full_counter.load() << endl;
+
+    if (actual_enqueue_count != expected_total_ops) {
+        cout << "Enqueue count mismatch" << endl;
+        return -1;
+    }
+
+    if (actual_dequeue_count != expected_total_ops) {
+        cout << "Dequeue count mismatch" << endl;
+        return -1;
+    }
+
+    // 3. Verify sum
+    if (sum_actual != sum.load(memory_order_seq_cst)) {
+        cout << "Sum mismatch" << endl;
+        return -1;
+    }
+
+    cout << "Peak RSS: " << peak_rss_kb() << " KB" << endl;
+    cout << "Test passed successfully" << endl;
+    return 0;
+}
+
+// One row of the bounded queue benchmark, producers yield while the ring is full
+int mpmc_ring_bench(int num_threads, vector<int>& arr, int iters, size_t capacity) {
+    mpmc_ring<int> myring(capacity);
+    double ops = run_throughput(num_threads, arr, iters,
+                                [&](int v) {
+                                    while (!myring.try_enqueue(v))
+                                        this_thread::yield();
+                                },
+                                [&]() { return myring.try_dequeue().has_value(); });
+    cout << "| MPMC_RING | " << myring.capacity() << " | " << num_threads << " | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
@@ -2,7 +2,15 @@
 #include <iostream>
 #include <vector>
 #include <thread>
+#include <optional>
+#include <memory>
 #include "common_header_file.h"
+#include "reclamation.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "backoff.h"
+#include "eventcount.h"
+#include "bench.h"
 #include <cassert>
 #include <fstream>
 
@@ -10,73 +18,187 @@ using namespace std;
 
 static void write_back_to_file(string out_file, vector<atomic<int>>& arr, int size);
 
+template<class T, class Reclaim = hp_reclaim, class Backoff = no_backoff>
 class msqueue{
 public:
-    class node{
+    class node : public pooled<node>{
         public:
-        node(int v):val(v){}
-        int val; atomic<node*> next = nullptr;
+        node(){}
+        template<class... Args>
+        node(Args&&... args){ val.construct(forward<Args>(args)...); }
+        value_cell<T> val; atomic<node*> next = nullptr;
     };
 private:    
     atomic<node*> head, tail;
+    // Parked dequeue_wait() callers
+    eventcount nonempty;
 public:
     msqueue();
-    void enqueue(int val);
-    int dequeue();
+    ~msqueue();
+    // Constructs the value in place inside the new node
+    template<class... Args>
+    void emplace(Args&&... args);
+    void enqueue(const T& val){ emplace(val); }
+    void enqueue(T&& val){ emplace(move(val)); }
+    // Moves the front value out, nullopt when the queue is empty
+    optional<T> dequeue();
+    // Like dequeue() but sleeps while the queue is empty, nullopt only once the timeout expired
+    optional<T> dequeue_wait(chrono::nanoseconds timeout = chrono::nanoseconds::max()){
+        return wait_for_item(nonempty, timeout, [this](){ return dequeue(); });
+    }
+    // Prefills the node arena so the first n enqueues do not allocate from malloc
+    void reserve(size_t n){ node_pool<node>::instance().reserve(n); }
 };
 
-msqueue::msqueue(){
-    node *dummy = new node(-1);
+template<class T, class Reclaim, class Backoff>
+msqueue<T, Reclaim, Backoff>::msqueue(){
+    node *dummy = new node();
     head.store(dummy);
     tail.store(dummy);
 }
-void msqueue::enqueue(int val){
+
+template<class T, class Reclaim, class Backoff>
+msqueue<T, Reclaim, Backoff>::~msqueue(){
+    // The dummy at head holds no value, every node after it does
+    node *n = head.load(memory_order_acquire);
+    bool is_dummy = true;
+    while(n != NULL){
+        node *next = n->next.load(memory_order_relaxed);
+        if(!is_dummy)
+            n->val.destroy();
+        delete n;
+        n = next;
+        is_dummy = false;
+    }
+}
+
+template<class T, class Reclaim, class Backoff>
+template<class... Args>
+void msqueue<T, Reclaim, Backoff>::emplace(Args&&... args){
+    typename Reclaim::guard g;
+    Backoff backoff;
     node *tail_node, *end, *new_node;
-    new_node = new node(val);
-    node* expected = nullptr;
+    new_node = new node(forward<Args>(args)...);
     while(true){
-        tail_node = tail.load(memory_order_acquire); 
+        node* expected = nullptr;
+        tail_node = g.protect(0, tail); 
         end = tail_node->next.load(memory_order_acquire);
         if(tail_node == tail.load(memory_order_acquire)){
-            if(end == NULL && tail_node->next.compare_exchange_strong(expected, new_node, memory_order_acq_rel))
-                break;
-            
-            else if(end!=NULL)
+            if(end == NULL){
+                // seq_cst pairs with the waiter registration in eventcount
+                if(tail_node->next.compare_exchange_strong(expected, new_node, memory_order_seq_cst))
+                    break;
+                backoff.fail(); // Another enqueue linked its node first
+            }
+            else
                 tail.compare_exchange_strong(tail_node,end, memory_order_acq_rel);
         }
     }
     tail.compare_exchange_strong(tail_node,new_node, memory_order_acq_rel);
+    nonempty.notify();
 }
 
-int msqueue::dequeue(){
+template<class T, class Reclaim, class Backoff>
+optional<T> msqueue<T, Reclaim, Backoff>::dequeue(){
+    typename Reclaim::guard g;
+    Backoff backoff;
     node *tail_node, *dummy_node, *new_node;
     while(true){
-        dummy_node = head.load(memory_order_acquire); 
+        dummy_node = g.protect(0, head); 
         tail_node = tail.load(memory_order_acquire); 
-        new_node = dummy_node->next.load(memory_order_acquire);
+        new_node = g.protect(1, dummy_node->next);
         if(dummy_node == head.load(memory_order_acquire)){
             if(dummy_node == tail_node){
                 if(new_node == NULL)
-                    return -1;
+                    return nullopt;
                 
                 else
                     tail.compare_exchange_strong(tail_node, new_node, memory_order_acq_rel);
             }
         else{
-            int ret = new_node->val;
-            if(head.compare_exchange_strong(dummy_node, new_node, memory_order_acq_rel))
-                return ret;
+            if constexpr (value_cell<T>::is_inline){
+                // Small values are read before the CAS as in the original algorithm
+                T ret = new_node->val.load();
+                if(head.compare_exchange_strong(dummy_node, new_node, memory_order_acq_rel)){
+                    // The old dummy is unreachable now, new_node becomes the dummy
+                    g.clear(0);
+                    Reclaim::retire(dummy_node);
+                    return ret;
+                }
+                backoff.fail();
+            }
+            else{
+                // Other values are moved out by the winner of the CAS only. new_node is
+                // the dummy from now on but stays protected by slot 1 until we are done.
+                if(head.compare_exchange_strong(dummy_node, new_node, memory_order_acq_rel)){
+                    optional<T> ret;
+                    new_node->val.move_to(ret);
+                    g.clear(0);
+                    Reclaim::retire(dummy_node);
+                    return ret;
+                }
+                backoff.fail();
+            }
             }
         }
     }
 }
    
     
+int msqueue_test_basic(void){
+    msqueue<int> myqueue;
+
+    for(int i = 0; i < 5; i++)
+        myqueue.enqueue(i);
+
+    for(int i = 0; i < 5; i++){
+        if(myqueue.dequeue() != i){
+            cout << "The queue is not behaving properly and there is some issue" << endl;
+            return -1;
+        }
+    }
+
+    if(myqueue.dequeue()){
+        cout << "should have returned nullopt as queue should be empty at this point" << endl;
+        return -1;
+    }
+
+    // Move only payloads are moved in and out without copies
+    msqueue<unique_ptr<int>> ptr_queue;
+    ptr_queue.emplace(new int(7));
+    ptr_queue.emplace(new int(8));
+    optional<unique_ptr<int>> p = ptr_queue.dequeue();
+    if(!p || **p != 7){
+        cout << "The queue of unique_ptr is not behaving properly" << endl;
+        return -1;
+    }
+
+    // Blocking dequeue: times out on an empty queue, wakes up for an enqueue from another thread
+    if(myqueue.dequeue_wait(chrono::milliseconds(1))){
+        cout << "dequeue_wait should have timed out on an empty queue" << endl;
+        return -1;
+    }
+    thread producer([&](){
+        this_thread::sleep_for(chrono::milliseconds(5));
+        myqueue.enqueue(9);
+    });
+    optional<int> w = myqueue.dequeue_wait();
+    producer.join();
+    if(w != 9){
+        cout << "dequeue_wait should have returned the value enqueued meanwhile" << endl;
+        return -1;
+    }
+
+    cout << "queue is working properly" << endl;
+    return 0;
+}
+
 // This test is designed in such a way that multiple threads will execute the queue methods and
 // it is possible that for example during enqueue the sequence can be mistmatched with the values enqueued as in real time
 // threads can be executed in interleaved manner. So, to test, summing up the values enqueued should be equal to the sum of the values dequeued.
     
-int msqueue_test_advanced(int num_threads, vector<int>&arr){
+template<class Reclaim, class Backoff>
+static int msqueue_test_run(int num_threads, vector<int>&arr){
     int num_thread_for_each_ops = (num_threads / 2);
     
     // Tracking mechanisms
@@ -92,7 +214,8 @@ int msqueue_test_advanced(int num_threads, vector<int>&arr){
     atomic<int> sum(0);
     int sum_actual = 0;
     
-    msqueue myqueue;
+    msqueue<int, Reclaim, Backoff> myqueue;
+    myqueue.reserve(num_thread_for_each_ops * arr.size());
     vector<thread> local_threads;
 
     // enqueue threads
@@ -116,20 +239,20 @@ int msqueue_test_advanced(int num_threads, vector<int>&arr){
     for (int i = 0; i < num_thread_for_each_ops; i++) {
         local_threads.push_back(thread([&, i]() {
             for (int j = 0; j < arr.size(); j++) {
-                int value = myqueue.dequeue();
+                optional<int> value = myqueue.dequeue();
                 
                 // Only process valid dequeue values
-                if (value != -1) {
+                if (value) {
                     // Track dequeue operation
                     int dequeue_index = dequeue_counter.fetch_add(1, memory_order_seq_cst);
                     assert(dequeue_index < test_dequeue_arr.size());
                     
                     // Store dequeueped value
                     int index = i * arr.size() + j;
-                    test_dequeue_arr[index].store(value, memory_order_seq_cst);
+                    test_dequeue_arr[index].store(*value, memory_order_seq_cst);
                     
                     // Update sum
-                    sum.fetch_add(value, memory_order_seq_cst);
+                    sum.fetch_add(*value, memory_order_seq_cst);
                 }
             }
         }));
@@ -148,7 +271,7 @@ int msqueue_test_advanced(int num_threads, vector<int>&arr){
     // Verification checks
     
     // 1. Check if final Queue is empty
-    if (myqueue.dequeue() != -1) {
+    if (myqueue.dequeue()) {
         cout << "Queue should be empty at this point" << endl;
         return -1;
     }
@@ -179,10 +302,92 @@ int msqueue_test_advanced(int num_threads, vector<int>&arr){
     }
     
     
+    cout << "Peak RSS: " << peak_rss_kb() << " KB" << endl;
     cout << "Test passed successfully" << endl;
     return 0;
 }
 
+int msqueue_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim, backoff_type backoff) {
+    if (msqueue_test_basic() != 0)
+        return -1;
+    return with_reclaim(reclaim, [&]<class Reclaim>() {
+        return with_backoff(backoff, [&]<class Backoff>() {
+            return msqueue_test_run<Reclaim, Backoff>(num_threads, arr);
+        });
+    });
+}
+
+template<class Reclaim, class Backoff = no_backoff>
+static double msqueue_throughput(int num_threads, vector<int>& arr, int iters) {
+    msqueue<int, Reclaim, Backoff> myqueue;
+    return run_throughput(num_threads, arr, iters,
+                          [&](int v) { myqueue.enqueue(v); },
+                          [&]() { return myqueue.dequeue().has_value(); });
+}
+
+// One row of the reclamation benchmark: throughput and peak RSS for the given scheme
+int msqueue_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim) {
+    double ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        return msqueue_throughput<Reclaim>(num_threads, arr, iters);
+    });
+    cout << "| M_and_S_QUEUE | " << reclaim_name(reclaim) << " | " << num_threads << " | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
+
+// One row of the bounded queue benchmark
+int msqueue_bench(int num_threads, vector<int>& arr, int iters) {
+    double ops = msqueue_throughput<hp_reclaim>(num_threads, arr, iters);
+    cout << "| M_and_S_QUEUE | unbounded | " << num_threads << " | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
+
+// One row of the latency benchmark
+int msqueue_latency_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim) {
+    latency_stats l = with_reclaim(reclaim, [&]<class Reclaim>() {
+        msqueue<int, Reclaim> myqueue;
+        return run_latency(num_threads, arr, iters,
+                           [&](int, int v) { myqueue.enqueue(v); },
+                           [&](int) { return myqueue.dequeue().has_value(); });
+    });
+    cout << "| M_and_S_QUEUE | " << num_threads << " | " << l.p50 << " | " << l.p99 << " | "
+         << l.p999 << " | " << l.max << " |" << endl;
+    return 0;
+}
+
+// One row of the backoff scaling benchmark
+int msqueue_backoff_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim, backoff_type backoff) {
+    double ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        return with_backoff(backoff, [&]<class Backoff>() {
+            return msqueue_throughput<Reclaim, Backoff>(num_threads, arr, iters);
+        });
+    });
+    cout << "| M_and_S_QUEUE | " << backoff_name(backoff) << " | " << num_threads << " | "
+         << (long)ops << " |" << endl;
+    return 0;
+}
+
+// Idle CPU and wake-up latency of consumers polling dequeue() against consumers parked in dequeue_wait()
+int msqueue_wait_bench(int num_threads, int rounds) {
+    for (bool parked : {false, true}) {
+        msqueue<int> myqueue;
+        wake_stats w = run_wake(num_threads, rounds,
+            [&](int v) { myqueue.enqueue(v); },
+            [&]() {
+                if (parked)
+                    return myqueue.dequeue_wait(chrono::milliseconds(10));
+                optional<int> v = myqueue.dequeue();
+                if (!v)
+                    this_thread::yield();
+                return v;
+            });
+        cout << "| M_and_S_QUEUE | " << (parked ? "dequeue_wait" : "poll") << " | " << num_threads << " | "
+             << (long)w.idle_cpu << " | " << w.p50 << " | " << w.max << " |" << endl;
+    }
+    return 0;
+}
+
 static void write_back_to_file(string out_file, vector<atomic<int>>& arr, int size) {
     ofstream output_file_var(out_file);
 
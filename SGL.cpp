@@ -5,7 +5,12 @@
 #include <atomic>
 #include <thread>
 #include <cassert>
+#include <optional>
+#include <chrono>
 #include "common_header_file.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "bench.h"
 
 using namespace std;
 
@@ -29,55 +34,168 @@ static void write_back_to_file(string out_file, vector<atomic<int>>& arr, int si
     output_file_var.close();
 }
 
-mutex sgl_lock;  // Lock for stack/queue operations
+// Growable circular buffer: the values sit in a power of two ring of slots from head on,
+// so both ends are O(1). A full ring doubles and moves its values over, which is the only
+// step that depends on the depth and happens once per doubling.
+template<class T>
+class circular_buffer {
+private:
+    // Plain storage, every access is under the container lock
+    vector<value_cell<T, false>> slots;
+    size_t head = 0;
+    size_t count = 0;
+
+    size_t mask() const { return slots.size() - 1; }
+    void grow();
+
+public:
+    circular_buffer() : slots(16) {}
+    ~circular_buffer();
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    template<class... Args>
+    void emplace_back(Args&&... args);
+    // Move the value out of the respective end, nullopt when empty
+    optional<T> pop_front();
+    optional<T> pop_back();
+};
+
+template<class T>
+circular_buffer<T>::~circular_buffer() {
+    for (size_t i = 0; i < count; i++)
+        slots[(head + i) & mask()].destroy();
+}
+
+template<class T>
+void circular_buffer<T>::grow() {
+    vector<value_cell<T, false>> bigger(slots.size() * 2);
+    for (size_t i = 0; i < count; i++)
+        bigger[i].construct(slots[(head + i) & mask()].take());
+    slots.swap(bigger);
+    head = 0;
+}
 
+template<class T>
+template<class... Args>
+void circular_buffer<T>::emplace_back(Args&&... args) {
+    if (count == slots.size())
+        grow();
+    slots[(head + count) & mask()].construct(forward<Args>(args)...);
+    count++;
+}
+
+template<class T>
+optional<T> circular_buffer<T>::pop_front() {
+    if (count == 0)
+        return nullopt;
+    optional<T> v;
+    slots[head].move_to(v);
+    head = (head + 1) & mask();
+    count--;
+    return v;
+}
+
+template<class T>
+optional<T> circular_buffer<T>::pop_back() {
+    if (count == 0)
+        return nullopt;
+    optional<T> v;
+    slots[(head + count - 1) & mask()].move_to(v);
+    count--;
+    return v;
+}
+
+// Lock is any BasicLockable, e.g. mutex or one of the lock classes of locks.h
+template<class T, class Lock = mutex>
 class sgl {
 private:
-    vector<int> arr;
+    Lock sgl_lock;  // Lock for stack/queue operations of this instance
+    circular_buffer<T> arr;
 
 public:
-    void sgl_push_stack(int val);
-    int sgl_pop_stack();
-
-    void sgl_enqueue_queue(int val);
-    int sgl_dequeue_queue();
+    template<class... Args>
+    void sgl_emplace_stack(Args&&... args);
+    void sgl_push_stack(T val) { sgl_emplace_stack(move(val)); }
+    optional<T> sgl_pop_stack();
+
+    template<class... Args>
+    void sgl_emplace_queue(Args&&... args);
+    void sgl_enqueue_queue(T val) { sgl_emplace_queue(move(val)); }
+    optional<T> sgl_dequeue_queue();
 };
 
 // Stack operations
-void sgl::sgl_push_stack(int val) {
-    lock_guard<mutex> lock(sgl_lock);
-    arr.push_back(val);
+template<class T, class Lock>
+template<class... Args>
+void sgl<T, Lock>::sgl_emplace_stack(Args&&... args) {
+    lock_guard<Lock> lock(sgl_lock);
+    arr.emplace_back(forward<Args>(args)...);
 }
 
-int sgl::sgl_pop_stack() {
-    lock_guard<mutex> lock(sgl_lock);
-
-    if (arr.empty()) return -1;
-
-    int val = arr.back();
-    arr.pop_back();
-    return val;
+template<class T, class Lock>
+optional<T> sgl<T, Lock>::sgl_pop_stack() {
+    lock_guard<Lock> lock(sgl_lock);
+    return arr.pop_back();
 }
 
 // Queue operations
-void sgl::sgl_enqueue_queue(int val) {
-    lock_guard<mutex> lock(sgl_lock);
-    arr.push_back(val);
+template<class T, class Lock>
+template<class... Args>
+void sgl<T, Lock>::sgl_emplace_queue(Args&&... args) {
+    lock_guard<Lock> lock(sgl_lock);
+    arr.emplace_back(forward<Args>(args)...);
 }
 
-int sgl::sgl_dequeue_queue() {
-    lock_guard<mutex> lock(sgl_lock);
+template<class T, class Lock>
+optional<T> sgl<T, Lock>::sgl_dequeue_queue() {
+    lock_guard<Lock> lock(sgl_lock);
+    return arr.pop_front();
+}
+
+// N independently locked sgl containers. A thread pushes to and pops from its home shard,
+// picked by its thread number, and steals from the other shards in turn when its home is
+// empty. Every shard keeps its own LIFO or FIFO order, there is no order across shards,
+// and a pop returns nullopt only after finding every shard empty at the time it looked.
+template<class T, class Lock = mutex>
+class sharded_sgl {
+    class alignas(CACHE_LINE_SIZE) shard {
+    public:
+        sgl<T, Lock> s;
+    };
+
+private:
+    vector<shard> shards;
+
+    sgl<T, Lock>& home() { return shards[thread_number() % shards.size()].s; }
+    template<class Pop>
+    optional<T> take(Pop pop);
 
-    if (arr.empty()) return -1;
+public:
+    sharded_sgl(size_t num_shards) : shards(max<size_t>(num_shards, 1)) {}
+    size_t num_shards() const { return shards.size(); }
+
+    void sgl_push_stack(T val) { home().sgl_push_stack(move(val)); }
+    optional<T> sgl_pop_stack() { return take([](sgl<T, Lock>& s) { return s.sgl_pop_stack(); }); }
+
+    void sgl_enqueue_queue(T val) { home().sgl_enqueue_queue(move(val)); }
+    optional<T> sgl_dequeue_queue() { return take([](sgl<T, Lock>& s) { return s.sgl_dequeue_queue(); }); }
+};
 
-    int val = arr.front();
-    arr.erase(arr.begin());
-    return val;
+template<class T, class Lock>
+template<class Pop>
+optional<T> sharded_sgl<T, Lock>::take(Pop pop) {
+    size_t h = thread_number() % shards.size();
+    for (size_t i = 0; i < shards.size(); i++) {
+        optional<T> v = pop(shards[(h + i) % shards.size()].s);
+        if (v)
+            return v;
+    }
+    return nullopt;
 }
 
 // Basic stack test
 int sgl_stack_test_basic(void) {
-    sgl mystack;
+    sgl<int> mystack;
 
     for (int i = 0; i < 5; i++) mystack.sgl_push_stack(i);
 
@@ -88,8 +206,8 @@ int sgl_stack_test_basic(void) {
         }
     }
 
-    if (mystack.sgl_pop_stack() != -1) {
-        cout << "should have returned -1 as stack should be empty at this point" << endl;
+    if (mystack.sgl_pop_stack()) {
+        cout << "should have returned nullopt as stack should be empty at this point" << endl;
         return -1;
     }
 
@@ -98,7 +216,8 @@ int sgl_stack_test_basic(void) {
 }
 
 // Advanced stack test with multiple threads
-int sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
+template<class Stack>
+static int sgl_stack_test_run(int num_threads, vector<int>& arr, Stack& mystack) {
     int num_thread_for_each_ops = num_threads / 2;
 
     vector<atomic<int>> test_push_arr(num_thread_for_each_ops * arr.size());
@@ -111,7 +230,6 @@ int sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
 
-    sgl mystack;
     vector<thread> local_threads;
 
     // Push threads
@@ -133,16 +251,16 @@ int sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
     for (int i = 0; i < num_thread_for_each_ops; i++) {
         local_threads.push_back(thread([&, i]() {
             for (int j = 0; j < arr.size(); j++) {
-                int value = mystack.sgl_pop_stack();
+                optional<int> value = mystack.sgl_pop_stack();
                 
-                if (value != -1) {
+                if (value) {
                     int pop_index = pop_counter.fetch_add(1, memory_order_seq_cst);
                     assert(pop_index < test_dequeue_arr.size());
 
                     int index = i * arr.size() + j;
-                    test_dequeue_arr[index].store(value, memory_order_seq_cst);
+                    test_dequeue_arr[index].store(*value, memory_order_seq_cst);
 
-                    sum.fetch_add(value, memory_order_seq_cst);
+                    sum.fetch_add(*value, memory_order_seq_cst);
                 }
             }
         }));
@@ -159,7 +277,7 @@ int sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
     }
 
     // Verification checks
-    if (mystack.sgl_pop_stack() != -1) {
+    if (mystack.sgl_pop_stack()) {
         cout << "Stack should be empty at this point" << endl;
         return -1;
     }
@@ -193,7 +311,7 @@ int sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
 
 // Basic queue test
 int sgl_queue_test_basic(void) {
-    sgl myqueue;
+    sgl<int> myqueue;
 
     for (int i = 0; i < 5; i++) myqueue.sgl_enqueue_queue(i);
 
@@ -204,17 +322,34 @@ int sgl_queue_test_basic(void) {
         }
     }
 
-    if (myqueue.sgl_dequeue_queue() != -1) {
-        cout << "should have returned -1 as queue should be empty at this point" << endl;
+    if (myqueue.sgl_dequeue_queue()) {
+        cout << "should have returned nullopt as queue should be empty at this point" << endl;
         return -1;
     }
 
+    // Wrap around the ring and grow it several times with values queued across the end
+    int next_in = 0, next_out = 0;
+    for (int round = 0; round < 100; round++) {
+        for (int k = 0; k < 3; k++) myqueue.sgl_enqueue_queue(next_in++);
+        if (myqueue.sgl_dequeue_queue() != next_out++) {
+            cout << "The queue lost its order while growing" << endl;
+            return -1;
+        }
+    }
+    while (next_out < next_in) {
+        if (myqueue.sgl_dequeue_queue() != next_out++) {
+            cout << "The queue lost its order while growing" << endl;
+            return -1;
+        }
+    }
+
     cout << "SGL queue is working properly" << endl;
     return 0;
 }
 
 // Advanced queue test with multiple threads
-int sgl_queue_test_advanced(int num_threads, vector<int>& arr) {
+template<class Queue>
+static int sgl_queue_test_run(int num_threads, vector<int>& arr, Queue& myqueue) {
     int num_thread_for_each_ops = num_threads / 2;
 
     vector<atomic<int>> test_enqueue_arr(num_thread_for_each_ops * arr.size());
@@ -227,7 +362,6 @@ int sgl_queue_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
 
-    sgl myqueue;
     vector<thread> local_threads;
 
     // Enqueue threads
@@ -249,16 +383,16 @@ int sgl_queue_test_advanced(int num_threads, vector<int>& arr) {
     for (int i = 0; i < num_thread_for_each_ops; i++) {
         local_threads.push_back(thread([&, i]() {
             for (int j = 0; j < arr.size(); j++) {
-                int value = myqueue.sgl_dequeue_queue();
+                optional<int> value = myqueue.sgl_dequeue_queue();
 
-                if (value != -1) {
+                if (value) {
                     int dequeue_index = dequeue_counter.fetch_add(1, memory_order_seq_cst);
                     assert(dequeue_index < test_dequeue_arr.size());
 
                     int index = i * arr.size() + j;
-                    test_dequeue_arr[index].store(value, memory_order_seq_cst);
+                    test_dequeue_arr[index].store(*value, memory_order_seq_cst);
 
-                    sum.fetch_add(value, memory_order_seq_cst);
+                    sum.fetch_add(*value, memory_order_seq_cst);
                 }
             }
         }));
@@ -275,7 +409,7 @@ int sgl_queue_test_advanced(int num_threads, vector<int>& arr) {
     }
 
     // Verification checks
-    if (myqueue.sgl_dequeue_queue() != -1) {
+    if (myqueue.sgl_dequeue_queue()) {
         cout << "Queue should be empty at this point" << endl;
         return -1;
     }
@@ -307,3 +441,171 @@ int sgl_queue_test_advanced(int num_threads, vector<int>& arr) {
     return 0;
 }
 
+// With shards > 1 the test runs on a sharded_sgl. Peterson locks take two contenders, so
+// with them the test runs one producer and one consumer.
+int sgl_stack_test_advanced(int num_threads, vector<int>& arr, int shards, locks_type lock) {
+    if (sgl_stack_test_basic() != 0)
+        return -1;
+    if (is_two_thread_lock(lock) && num_threads != 2) {
+        cout << "Peterson locks take two contenders, running with 2 threads" << endl;
+        num_threads = 2;
+    }
+    cout << "Lock: " << lock_name(lock) << endl;
+    return with_lock(lock, [&]<class Lock>() {
+        if (shards > 1) {
+            sharded_sgl<int, Lock> mystack(shards);
+            return sgl_stack_test_run(num_threads, arr, mystack);
+        }
+        sgl<int, Lock> mystack;
+        return sgl_stack_test_run(num_threads, arr, mystack);
+    });
+}
+
+int sgl_queue_test_advanced(int num_threads, vector<int>& arr, int shards, locks_type lock) {
+    if (sgl_queue_test_basic() != 0)
+        return -1;
+    if (is_two_thread_lock(lock) && num_threads != 2) {
+        cout << "Peterson locks take two contenders, running with 2 threads" << endl;
+        num_threads = 2;
+    }
+    cout << "Lock: " << lock_name(lock) << endl;
+    return with_lock(lock, [&]<class Lock>() {
+        if (shards > 1) {
+            sharded_sgl<int, Lock> myqueue(shards);
+            return sgl_queue_test_run(num_threads, arr, myqueue);
+        }
+        sgl<int, Lock> myqueue;
+        return sgl_queue_test_run(num_threads, arr, myqueue);
+    });
+}
+
+// One row of the bounded queue benchmark
+int sgl_queue_bench(int num_threads, vector<int>& arr, int iters) {
+    sgl<int> myqueue;
+    double ops = run_throughput(num_threads, arr, iters,
+                                [&](int v) { myqueue.sgl_enqueue_queue(v); },
+                                [&]() { return myqueue.sgl_dequeue_queue().has_value(); });
+    cout << "| SGL_QUEUE | unbounded | " << num_threads << " | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
+
+// Queue depth against the cost of an operation. The queue is prefilled to each depth, then
+// one thread times enqueue/dequeue pairs, i.e. two lock hold times, and all threads run the
+// throughput loop on top of the prefilled values.
+int sgl_queue_depth_bench(int num_threads, vector<int>& arr, int iters) {
+    cout << "| Container | Depth | Pair (ns) | Threads | Ops/sec |" << endl;
+    cout << "|-----------|-------|-----------|---------|---------|" << endl;
+    for (long depth : {10L, 1000L, 100000L, 10000000L}) {
+        sgl<int> myqueue;
+        for (long i = 0; i < depth; i++)
+            myqueue.sgl_enqueue_queue(i);
+
+        const int pairs = 1000000;
+        auto begin = chrono::steady_clock::now();
+        for (int i = 0; i < pairs; i++) {
+            myqueue.sgl_enqueue_queue(i);
+            myqueue.sgl_dequeue_queue();
+        }
+        double pair_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / pairs;
+
+        double ops = run_throughput(num_threads, arr, iters,
+                                    [&](int v) { myqueue.sgl_enqueue_queue(v); },
+                                    [&]() { return myqueue.sgl_dequeue_queue().has_value(); });
+        cout << "| SGL_QUEUE | " << depth << " | " << (long)pair_ns << " | " << num_threads << " | "
+             << (long)ops << " |" << endl;
+    }
+    return 0;
+}
+
+// Throughput of the sharded stack and queue for 1, 2, 4, ... shards. With more shards than
+// producer/consumer pairs the homes of producers and consumers no longer overlap and every
+// pop steals, so the table stops at one shard per pair.
+int sgl_shards_bench(int num_threads, vector<int>& arr, int iters) {
+    int max_shards = max(num_threads / 2, 1);
+    cout << "| Container | Shards | Threads | Ops/sec |" << endl;
+    cout << "|-----------|--------|---------|---------|" << endl;
+    for (int shards = 1; shards <= max_shards; shards *= 2) {
+        sharded_sgl<int> mystack(shards);
+        double ops = run_throughput(num_threads, arr, iters,
+                                    [&](int v) { mystack.sgl_push_stack(v); },
+                                    [&]() { return mystack.sgl_pop_stack().has_value(); });
+        cout << "| SGL_STACK | " << shards << " | " << num_threads << " | " << (long)ops << " |" << endl;
+    }
+    for (int shards = 1; shards <= max_shards; shards *= 2) {
+        sharded_sgl<int> myqueue(shards);
+        double ops = run_throughput(num_threads, arr, iters,
+                                    [&](int v) { myqueue.sgl_enqueue_queue(v); },
+                                    [&]() { return myqueue.sgl_dequeue_queue().has_value(); });
+        cout << "| SGL_QUEUE | " << shards << " | " << num_threads << " | " << (long)ops << " |" << endl;
+    }
+    return 0;
+}
+
+// Throughput of the stack and the queue for every lock kind (or only the given one) at
+// 2, 4, 8, ... up to num_threads threads. Peterson locks only get the 2 thread rows.
+int sgl_lock_bench(int num_threads, vector<int>& arr, int iters, locks_type only, bool only_given) {
+    cout << "| Container | Lock | Threads | Ops/sec |" << endl;
+    cout << "|-----------|------|---------|---------|" << endl;
+    for (int l = PTHREAD_LOCK; l < NO_LOCK; l++) {
+        locks_type lock = (locks_type)l;
+        if (only_given && lock != only)
+            continue;
+        for (int t = 2; t <= max(num_threads, 2); t *= 2) {
+            if (is_two_thread_lock(lock) && t != 2)
+                break;
+            auto [stack_ops, queue_ops] = with_lock(lock, [&]<class Lock>() {
+                sgl<int, Lock> mystack;
+                double s = run_throughput(t, arr, iters,
+                                          [&](int v) { mystack.sgl_push_stack(v); },
+                                          [&]() { return mystack.sgl_pop_stack().has_value(); });
+                sgl<int, Lock> myqueue;
+                double q = run_throughput(t, arr, iters,
+                                          [&](int v) { myqueue.sgl_enqueue_queue(v); },
+                                          [&]() { return myqueue.sgl_dequeue_queue().has_value(); });
+                return pair<double, double>(s, q);
+            });
+            cout << "| SGL_STACK | " << lock_name(lock) << " | " << t << " | " << (long)stack_ops << " |" << endl;
+            cout << "| SGL_QUEUE | " << lock_name(lock) << " | " << t << " | " << (long)queue_ops << " |" << endl;
+        }
+    }
+    return 0;
+}
+
+// Uncontended lock/unlock time of Lock, in ns
+template<class Lock>
+static double lock_unlock_ns(long rounds) {
+    Lock l;
+    auto begin = chrono::steady_clock::now();
+    for (long i = 0; i < rounds; i++) {
+        l.lock();
+        l.unlock();
+    }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / rounds;
+}
+
+// Lock classes against the switch based locks_lock path: object size, uncontended
+// lock/unlock time and SGL stack throughput, per lock kind (or only the given one)
+int lock_dispatch_bench(int num_threads, vector<int>& arr, int iters, locks_type only, bool only_given) {
+    cout << "| Lock | Path | Size (bytes) | Lock+unlock (ns) | Threads | SGL_STACK Ops/sec |" << endl;
+    cout << "|------|------|--------------|------------------|---------|-------------------|" << endl;
+    for (int l = PTHREAD_LOCK; l < NO_LOCK; l++) {
+        locks_type lock = (locks_type)l;
+        if (only_given && lock != only)
+            continue;
+        int t = is_two_thread_lock(lock) ? 2 : num_threads;
+        auto row = [&]<class Lock>(const char* path) {
+            sgl<int, Lock> mystack;
+            double ops = run_throughput(t, arr, iters,
+                                        [&](int v) { mystack.sgl_push_stack(v); },
+                                        [&]() { return mystack.sgl_pop_stack().has_value(); });
+            cout << "| " << lock_name(lock) << " | " << path << " | " << sizeof(Lock) << " | "
+                 << lock_unlock_ns<Lock>(10000000) << " | " << t << " | " << (long)ops << " |" << endl;
+            return 0;
+        };
+        if (has_switch_lock(lock))
+            with_switch_lock(lock, [&]<class Lock>() { return row.template operator()<Lock>("switch"); });
+        with_lock(lock, [&]<class Lock>() { return row.template operator()<Lock>("class"); });
+    }
+    return 0;
+}
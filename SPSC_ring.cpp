@@ -0,0 +1,182 @@
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <optional>
+#include "common_header_file.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "bench.h"
+
+using namespace std;
+
+// Bounded single producer single consumer queue over a power of two ring.
+// The producer alone writes write_idx and the consumer alone writes read_idx, so both sides
+// only load and store, there is no read-modify-write on the fast path. Each side also keeps
+// a private copy of the other side's index and reloads the shared one only when the copy
+// says the ring is full (producer) or empty (consumer).
+template<class T>
+class spsc_ring {
+private:
+    vector<value_cell<T>> slots;
+    size_t mask;
+
+    // Producer side
+    alignas(CACHE_LINE_SIZE) atomic<size_t> write_idx{0};
+    size_t read_idx_cache = 0;
+
+    // Consumer side
+    alignas(CACHE_LINE_SIZE) atomic<size_t> read_idx{0};
+    size_t write_idx_cache = 0;
+
+public:
+    // capacity is rounded up to a power of two
+    spsc_ring(size_t capacity) : slots(round_up_pow2(capacity)), mask(slots.size() - 1) {}
+    ~spsc_ring();
+    size_t capacity() const { return mask + 1; }
+    // Producer only. Constructs the value in place, false when the ring is full
+    template<class... Args>
+    bool try_emplace(Args&&... args);
+    bool try_enqueue(const T& val) { return try_emplace(val); }
+    bool try_enqueue(T&& val) { return try_emplace(move(val)); }
+    // Consumer only. Moves the front value out, nullopt when the ring is empty
+    optional<T> try_dequeue();
+};
+
+template<class T>
+spsc_ring<T>::~spsc_ring() {
+    size_t end = write_idx.load(memory_order_relaxed);
+    for (size_t i = read_idx.load(memory_order_relaxed); i != end; i++)
+        slots[i & mask].destroy();
+}
+
+template<class T>
+template<class... Args>
+bool spsc_ring<T>::try_emplace(Args&&... args) {
+    size_t w = write_idx.load(memory_order_relaxed);
+    if (w - read_idx_cache == capacity()) {
+        read_idx_cache = read_idx.load(memory_order_acquire);
+        if (w - read_idx_cache == capacity())
+            return false; // Full
+    }
+    slots[w & mask].construct(forward<Args>(args)...);
+    write_idx.store(w + 1, memory_order_release); // publishes the value
+    return true;
+}
+
+template<class T>
+optional<T> spsc_ring<T>::try_dequeue() {
+    size_t r = read_idx.load(memory_order_relaxed);
+    if (r == write_idx_cache) {
+        write_idx_cache = write_idx.load(memory_order_acquire);
+        if (r == write_idx_cache)
+            return nullopt; // Empty
+    }
+    optional<T> v;
+    slots[r & mask].move_to(v);
+    read_idx.store(r + 1, memory_order_release); // hands the slot back to the producer
+    return v;
+}
+
+// One producer pushes every value of arr, one consumer pops them and checks the order
+int spsc_ring_test_advanced(int num_threads, vector<int>& arr, size_t capacity) {
+    if (num_threads != 2)
+        cout << "SPSC queue takes exactly one producer and one consumer, running with 2 threads" << endl;
+
+    // Atomic counters for tracking
+    atomic<int> enqueue_counter(0);
+    atomic<int> dequeue_counter(0);
+    bool in_order = true;
+
+    // Total sum tracking
+    long sum = 0;
+    long sum_actual = 0;
+
+    spsc_ring<int> myring(capacity);
+
+    // enqueue thread
+    thread producer([&]() {
+        for (size_t j = 0; j < arr.size(); j++) {
+            while (!myring.try_enqueue(arr[j]))
+                this_thread::yield();
+            enqueue_counter.fetch_add(1, memory_order_seq_cst);
+        }
+    });
+
+    // dequeue thread
+    thread consumer([&]() {
+        for (size_t j = 0; j < arr.size(); j++) {
+            optional<int> value;
+            while (!(value = myring.try_dequeue()))
+                this_thread::yield();
+            if (*value != arr[j])
+                in_order = false;
+            dequeue_counter.fetch_add(1, memory_order_seq_cst);
+            sum += *value;
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    // Calculate expected sum
+    for (size_t j = 0; j < arr.size(); j++) {
+        sum_actual += arr[j];
+    }
+
+    // Verification checks
+
+    // 1. Check if final ring is empty
+    if (myring.try_dequeue()) {
+        cout << "Ring should be empty at this point" << endl;
+        return -1;
+    }
+
+    // 2. Verify enqueue and dequeue counts
+    int expected_total_ops = arr.size();
+    int actual_enqueue_count = enqueue_counter.load(memory_order_seq_cst);
+    int actual_dequeue_count = dequeue_counter.load(memory_order_seq_cst);
+
+    cout << "Capacity: " << myring.capacity() << endl;
+    cout << "Expected total operations: " << expected_total_ops << endl;
+    cout << "Actual enqueue count: " << actual_enqueue_count << endl;
+    cout << "Actual dequeue count: " << actual_dequeue_count << endl;
+
+    if (actual_enqueue_count != expected_total_ops) {
+        cout << "Enqueue count mismatch" << endl;
+        return -1;
+    }
+
+    if (actual_dequeue_count != expected_total_ops) {
+        cout << "Dequeue count mismatch" << endl;
+        return -1;
+    }
+
+    // 3. Verify sum and FIFO order
+    if (sum_actual != sum) {
+        cout << "Sum mismatch" << endl;
+        return -1;
+    }
+
+    if (!in_order) {
+        cout << "Values were dequeued out of order" << endl;
+        return -1;
+    }
+
+    cout << "Test passed successfully" << endl;
+    return 0;
+}
+
+// One row of the SPSC benchmark, always one producer and one consumer
+int spsc_ring_bench(vector<int>& arr, int iters, size_t capacity) {
+    spsc_ring<int> myring(capacity);
+    double ops = run_throughput(2, arr, iters,
+                                [&](int v) {
+                                    while (!myring.try_enqueue(v))
+                                        this_thread::yield();
+                                },
+                                [&]() { return myring.try_dequeue().has_value(); });
+    cout << "| SPSC_RING | " << myring.capacity() << " | 2 | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
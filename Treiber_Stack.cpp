@@ -4,59 +4,362 @@
 #include <thread>
 #include <fstream>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include "common_header_file.h"
+#include "reclamation.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "backoff.h"
+#include "eventcount.h"
+#include "bench.h"
 
 using namespace std;
 
 static void write_back_to_file(string out_file, vector<atomic<int>>& arr);
 
+template<class T, class Reclaim = hp_reclaim, class Backoff = no_backoff>
 class tstack {
-    class node {
+    class node : public pooled<node> {
     public:
-        atomic<int> val;
+        value_cell<T> val;
         atomic<node*> down;
-        node(int v) {
-            val.store(v);
+        template<class... Args>
+        node(Args&&... args) {
+            val.construct(forward<Args>(args)...);
             down.store(nullptr);
         }
     };
 private:
     atomic<node*> top;
+    // Parked pop_wait() callers
+    eventcount nonempty;
 public:
     tstack() {
         top.store(nullptr);
     }
-    void push(int val);
-    int pop();
+    ~tstack();
+    // Constructs the value in place inside the new node
+    template<class... Args>
+    void emplace(Args&&... args);
+    void push(const T& val) { emplace(val); }
+    void push(T&& val) { emplace(move(val)); }
+    // Moves the top value out, nullopt when the stack is empty
+    optional<T> pop();
+    // Like pop() but sleeps while the stack is empty, nullopt only once the timeout expired
+    optional<T> pop_wait(chrono::nanoseconds timeout = chrono::nanoseconds::max()) {
+        return wait_for_item(nonempty, timeout, [this]() { return pop(); });
+    }
+
+    // Pushes [first, last) with a single CAS, *(last - 1) ends up on top
+    template<class It>
+    void push_range(It first, It last);
+    // Pops up to k values with a single CAS, writes them top first to out and returns the count
+    template<class OutIt>
+    size_t pop_n(size_t k, OutIt out);
+    // Takes the whole stack with a single exchange
+    template<class OutIt>
+    size_t pop_all(OutIt out);
+
+    // Prefills the node arena so the first n pushes do not allocate from malloc
+    void reserve(size_t n) { node_pool<node>::instance().reserve(n); }
 };
 
-void tstack::push(int val) {
-    node* n = new node(val);
-    node* t;
-    do {
-        t = top.load(memory_order_acquire);
+template<class T, class Reclaim, class Backoff>
+tstack<T, Reclaim, Backoff>::~tstack() {
+    node* t = top.load(memory_order_acquire);
+    while (t != nullptr) {
+        node* n = t->down.load(memory_order_relaxed);
+        t->val.destroy();
+        delete t;
+        t = n;
+    }
+}
+
+template<class T, class Reclaim, class Backoff>
+template<class... Args>
+void tstack<T, Reclaim, Backoff>::emplace(Args&&... args) {
+    node* n = new node(forward<Args>(args)...);
+    Backoff backoff;
+    node* t = top.load(memory_order_acquire);
+    while (true) {
         n->down.store(t, memory_order_release);
-    } while (!top.compare_exchange_strong(t, n, memory_order_acq_rel)); // linearization point
+        // seq_cst pairs with the waiter registration in eventcount
+        if (top.compare_exchange_strong(t, n, memory_order_seq_cst)) // linearization point
+            break;
+        backoff.fail(); // t holds the new top
+    }
+    nonempty.notify();
 }
 
-int tstack::pop() {
+template<class T, class Reclaim, class Backoff>
+optional<T> tstack<T, Reclaim, Backoff>::pop() {
+    typename Reclaim::guard g;
+    Backoff backoff;
     node* t;
     node* n;
-    int v;
-    do {
-        t = top.load(memory_order_acquire);
+    while (true) {
+        t = g.protect(0, top); // t cannot be freed or reused while it is protected
         if (t == nullptr)
-            return -1; // Stack is empty
+            return nullopt; // Stack is empty
         n = t->down.load(memory_order_acquire);
-        v = t->val.load(memory_order_acquire);
-    } while (!top.compare_exchange_strong(t, n, memory_order_acq_rel)); // linearization point
+        if (top.compare_exchange_strong(t, n, memory_order_acq_rel)) // linearization point
+            break;
+        backoff.fail();
+    }
+
+    // Only the winner of the CAS touches the value
+    optional<T> v;
+    t->val.move_to(v);
+    g.clear(0);
+    Reclaim::retire(t); // Freed once no other popper can still be reading t->down
+    return v;
+}
+
+template<class T, class Reclaim, class Backoff>
+template<class It>
+void tstack<T, Reclaim, Backoff>::push_range(It first, It last) {
+    if (first == last)
+        return;
+
+    // Link a private chain, nobody else can see it before the CAS
+    node* bottom = new node(*first);
+    node* chain = bottom;
+    for (++first; first != last; ++first) {
+        node* n = new node(*first);
+        n->down.store(chain, memory_order_relaxed);
+        chain = n;
+    }
+
+    Backoff backoff;
+    node* t = top.load(memory_order_acquire);
+    while (true) {
+        bottom->down.store(t, memory_order_release);
+        if (top.compare_exchange_strong(t, chain, memory_order_seq_cst)) // linearization point
+            break;
+        backoff.fail();
+    }
+    nonempty.notify();
+}
+
+template<class T, class Reclaim, class Backoff>
+template<class OutIt>
+size_t tstack<T, Reclaim, Backoff>::pop_n(size_t k, OutIt out) {
+    if (k == 0)
+        return 0;
+
+    typename Reclaim::guard g;
+    Backoff backoff;
+    node* t;
+    node* last;
+    size_t count;
+    while (true) {
+        t = g.protect(0, top);
+        if (t == nullptr)
+            return 0; // Stack is empty
+
+        // Walk down to the k-th node. While top is still t nothing below t can have been
+        // popped, so every node protected before that check is still linked.
+        last = t;
+        count = 1;
+        bool valid = true;
+        while (count < k) {
+            node* n = g.protect(1 + count % 2, last->down);
+            if (n == nullptr)
+                break;
+            if (top.load(memory_order_acquire) != t) {
+                valid = false;
+                break;
+            }
+            last = n;
+            count++;
+        }
+        if (!valid)
+            continue;
+
+        node* rest = last->down.load(memory_order_acquire);
+        if (top.compare_exchange_strong(t, rest, memory_order_acq_rel)) // linearization point
+            break;
+        backoff.fail();
+    }
+
+    // t..last are private now
+    node* n = t;
+    for (size_t i = 0; i < count; i++) {
+        node* next = n->down.load(memory_order_relaxed);
+        *out++ = n->val.take();
+        Reclaim::retire(n);
+        n = next;
+    }
+    return count;
+}
+
+template<class T, class Reclaim, class Backoff>
+template<class OutIt>
+size_t tstack<T, Reclaim, Backoff>::pop_all(OutIt out) {
+    node* t = top.exchange(nullptr, memory_order_acq_rel); // linearization point
+
+    // Other poppers may still read the detached nodes, so they are retired, not deleted
+    size_t count = 0;
+    while (t != nullptr) {
+        node* next = t->down.load(memory_order_relaxed);
+        *out++ = t->val.take();
+        Reclaim::retire(t);
+        t = next;
+        count++;
+    }
+    return count;
+}
+
+// Tops of the tagged stack. Every successful CAS installs {pointer, version + 1}, so a
+// popper that read an old top fails its CAS even if the same node is back on top.
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+// {pointer, 64 bit version} pair swapped with one double width CAS (cmpxchg16b)
+template<class N>
+class dwcas_top {
+public:
+    class alignas(16) snapshot {
+    public:
+        N* ptr;
+        uint64_t tag;
+    };
+
+private:
+    snapshot top;
+
+public:
+    dwcas_top() : top{nullptr, 0} {}
+
+    // The halves are read separately; a torn snapshot simply fails the following CAS
+    snapshot load() {
+        snapshot s;
+        s.tag = __atomic_load_n(&top.tag, __ATOMIC_ACQUIRE);
+        s.ptr = __atomic_load_n(&top.ptr, __ATOMIC_ACQUIRE);
+        return s;
+    }
+
+    bool cas(const snapshot& expected, N* desired) {
+        snapshot d{desired, expected.tag + 1};
+        unsigned __int128 e128, d128;
+        memcpy(&e128, &expected, sizeof(e128));
+        memcpy(&d128, &d, sizeof(d128));
+        return __sync_bool_compare_and_swap(reinterpret_cast<unsigned __int128*>(&top), e128, d128);
+    }
+};
+#endif
+
+// Fallback for targets without a double width CAS: user space pointers fit in 48 bits,
+// the upper 16 bits of the word hold the version. ABA needs exactly 65536 pops between
+// a popper's read and its CAS.
+#define TOP_TAG_SHIFT 48
+#define TOP_PTR_MASK ((uint64_t(1) << TOP_TAG_SHIFT) - 1)
+
+template<class N>
+class packed_top {
+public:
+    class snapshot {
+    public:
+        N* ptr;
+        uint64_t word;
+    };
+
+private:
+    atomic<uint64_t> top;
+
+public:
+    packed_top() : top(0) {}
+
+    snapshot load() {
+        uint64_t w = top.load(memory_order_acquire);
+        return {reinterpret_cast<N*>(w & TOP_PTR_MASK), w};
+    }
+
+    bool cas(snapshot& expected, N* desired) {
+        uint64_t tag = (expected.word >> TOP_TAG_SHIFT) + 1;
+        uint64_t d = (reinterpret_cast<uint64_t>(desired) & TOP_PTR_MASK) | (tag << TOP_TAG_SHIFT);
+        return top.compare_exchange_strong(expected.word, d, memory_order_acq_rel);
+    }
+};
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+template<class N> using tagged_top = dwcas_top<N>;
+#else
+template<class N> using tagged_top = packed_top<N>;
+#endif
+
+// Treiber stack whose top carries a version counter. Popped nodes go straight back to the
+// node arena: the arena never returns memory to malloc, so a popper that still reads
+// t->down of a recycled node reads valid memory and the version makes its CAS fail.
+template<class T, template<class> class Top = tagged_top>
+class tagged_tstack {
+    class node : public pooled<node> {
+    public:
+        value_cell<T> val;
+        atomic<node*> down;
+        template<class... Args>
+        node(Args&&... args) {
+            val.construct(forward<Args>(args)...);
+            down.store(nullptr, memory_order_relaxed);
+        }
+    };
+private:
+    Top<node> top;
+public:
+    ~tagged_tstack();
+    template<class... Args>
+    void emplace(Args&&... args);
+    void push(const T& val) { emplace(val); }
+    void push(T&& val) { emplace(move(val)); }
+    optional<T> pop();
+    // Prefills the node arena so the first n pushes do not allocate from malloc
+    void reserve(size_t n) { node_pool<node>::instance().reserve(n); }
+};
+
+template<class T, template<class> class Top>
+tagged_tstack<T, Top>::~tagged_tstack() {
+    node* t = top.load().ptr;
+    while (t != nullptr) {
+        node* n = t->down.load(memory_order_relaxed);
+        t->val.destroy();
+        delete t;
+        t = n;
+    }
+}
 
-    delete t; // Free memory after pop
+template<class T, template<class> class Top>
+template<class... Args>
+void tagged_tstack<T, Top>::emplace(Args&&... args) {
+    node* n = new node(forward<Args>(args)...);
+    typename Top<node>::snapshot t;
+    do {
+        t = top.load();
+        n->down.store(t.ptr, memory_order_relaxed);
+    } while (!top.cas(t, n)); // linearization point
+}
+
+template<class T, template<class> class Top>
+optional<T> tagged_tstack<T, Top>::pop() {
+    typename Top<node>::snapshot t;
+    node* n;
+    do {
+        t = top.load();
+        if (t.ptr == nullptr)
+            return nullopt; // Stack is empty
+        n = t.ptr->down.load(memory_order_acquire);
+    } while (!top.cas(t, n)); // linearization point
+
+    optional<T> v;
+    t.ptr->val.move_to(v);
+    delete t.ptr; // No hazard pointer needed, see the class comment
     return v;
 }
 
 int tstack_test_basic(void) {
-    tstack mystack;
+    tstack<int> mystack;
 
     for (int i = 0; i < 5; i++)
         mystack.push(i);
@@ -68,8 +371,47 @@ int tstack_test_basic(void) {
         }
     }
 
-    if (mystack.pop() != -1) {
-        cout << "should have returned -1 as stack should be empty at this point" << endl;
+    if (mystack.pop()) {
+        cout << "should have returned nullopt as stack should be empty at this point" << endl;
+        return -1;
+    }
+
+    // Bulk operations
+    vector<int> values = {0, 1, 2, 3, 4};
+    vector<int> popped;
+    mystack.push_range(values.begin(), values.end());
+    if (mystack.pop_n(2, back_inserter(popped)) != 2 || popped != vector<int>{4, 3}) {
+        cout << "pop_n should have returned the two values on top" << endl;
+        return -1;
+    }
+    popped.clear();
+    if (mystack.pop_all(back_inserter(popped)) != 3 || popped != vector<int>{2, 1, 0}) {
+        cout << "pop_all should have returned the rest of the stack" << endl;
+        return -1;
+    }
+
+    // Move only payloads are moved in and out without copies
+    tstack<unique_ptr<int>> ptr_stack;
+    ptr_stack.emplace(new int(7));
+    optional<unique_ptr<int>> p = ptr_stack.pop();
+    if (!p || **p != 7 || ptr_stack.pop()) {
+        cout << "The stack of unique_ptr is not behaving properly" << endl;
+        return -1;
+    }
+
+    // Blocking pop: times out on an empty stack, wakes up for a push from another thread
+    if (mystack.pop_wait(chrono::milliseconds(1))) {
+        cout << "pop_wait should have timed out on an empty stack" << endl;
+        return -1;
+    }
+    thread pusher([&]() {
+        this_thread::sleep_for(chrono::milliseconds(5));
+        mystack.push(9);
+    });
+    optional<int> w = mystack.pop_wait();
+    pusher.join();
+    if (w != 9) {
+        cout << "pop_wait should have returned the value pushed meanwhile" << endl;
         return -1;
     }
 
@@ -77,7 +419,9 @@ int tstack_test_basic(void) {
     return 0;
 }
 
-int tstack_test_advanced(int num_threads, vector<int>& arr) {
+// With batch > 1 the pushers use push_range and the poppers pop_n, batch values at a time
+template<class Stack>
+static int tstack_test_run(int num_threads, vector<int>& arr, int batch = 1) {
     int num_thread_for_each_ops = (num_threads / 2);
     
     // Tracking mechanisms
@@ -93,47 +437,94 @@ int tstack_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
     
-    tstack mystack;
+    Stack mystack;
+    mystack.reserve(num_thread_for_each_ops * arr.size());
     vector<thread> local_threads;
 
-    // Push threads
-    for (int i = 0; i < num_thread_for_each_ops; i++) {
-        local_threads.push_back(thread([&, i]() {
-            for (int j = 0; j < arr.size(); j++) {
-                mystack.push(arr[j]);
-                
-                // Track push operation
-                int push_index = push_counter.fetch_add(1, memory_order_seq_cst);
-                assert(push_index < test_push_arr.size());
-                
-                // Store pushed value
-                int test_index = test_counter.fetch_add(1, memory_order_seq_cst);
-                test_push_arr[test_index].store(arr[j], memory_order_seq_cst);
+    // Batched push and pop threads
+    bool batched = false;
+    if constexpr (requires { mystack.pop_n(size_t(1), (int*)nullptr); }) {
+        batched = batch > 1;
+        if (batched) {
+            for (int i = 0; i < num_thread_for_each_ops; i++) {
+                local_threads.push_back(thread([&, i]() {
+                    for (int j = 0; j < arr.size(); j += batch) {
+                        int count = min<int>(batch, arr.size() - j);
+                        mystack.push_range(arr.begin() + j, arr.begin() + j + count);
+
+                        // Track push operations
+                        int push_index = push_counter.fetch_add(count, memory_order_seq_cst);
+                        assert(push_index + count <= test_push_arr.size());
+
+                        // Store pushed values
+                        int test_index = test_counter.fetch_add(count, memory_order_seq_cst);
+                        for (int m = 0; m < count; m++)
+                            test_push_arr[test_index + m].store(arr[j + m], memory_order_seq_cst);
+                    }
+                }));
+            }
+
+            for (int i = 0; i < num_thread_for_each_ops; i++) {
+                local_threads.push_back(thread([&, i]() {
+                    vector<int> values(batch);
+                    for (int j = 0; j < arr.size(); j += batch) {
+                        int count = mystack.pop_n(min<int>(batch, arr.size() - j), values.begin());
+
+                        // Track pop operations
+                        int pop_index = pop_counter.fetch_add(count, memory_order_seq_cst);
+                        assert(pop_index + count <= test_pop_arr.size());
+
+                        // Store popped values and update sum
+                        for (int m = 0; m < count; m++) {
+                            test_pop_arr[i * arr.size() + j + m].store(values[m], memory_order_seq_cst);
+                            sum.fetch_add(values[m], memory_order_seq_cst);
+                        }
+                    }
+                }));
             }
-        }));
+        }
     }
 
-    // Pop threads
-    for (int i = 0; i < num_thread_for_each_ops; i++) {
-        local_threads.push_back(thread([&, i]() {
-            for (int j = 0; j < arr.size(); j++) {
-                int value = mystack.pop();
+    if (!batched) {
+        // Push threads
+        for (int i = 0; i < num_thread_for_each_ops; i++) {
+            local_threads.push_back(thread([&, i]() {
+                for (int j = 0; j < arr.size(); j++) {
+                    mystack.push(arr[j]);
                 
-                // Only process valid pop values
-                if (value != -1) {
-                    // Track pop operation
-                    int pop_index = pop_counter.fetch_add(1, memory_order_seq_cst);
-                    assert(pop_index < test_pop_arr.size());
+                    // Track push operation
+                    int push_index = push_counter.fetch_add(1, memory_order_seq_cst);
+                    assert(push_index < test_push_arr.size());
+                
+                    // Store pushed value
+                    int test_index = test_counter.fetch_add(1, memory_order_seq_cst);
+                    test_push_arr[test_index].store(arr[j], memory_order_seq_cst);
+                }
+            }));
+        }
+
+        // Pop threads
+        for (int i = 0; i < num_thread_for_each_ops; i++) {
+            local_threads.push_back(thread([&, i]() {
+                for (int j = 0; j < arr.size(); j++) {
+                    optional<int> value = mystack.pop();
+                
+                    // Only process valid pop values
+                    if (value) {
+                        // Track pop operation
+                        int pop_index = pop_counter.fetch_add(1, memory_order_seq_cst);
+                        assert(pop_index < test_pop_arr.size());
                     
-                    // Store popped value
-                    int index = i * arr.size() + j;
-                    test_pop_arr[index].store(value, memory_order_seq_cst);
+                        // Store popped value
+                        int index = i * arr.size() + j;
+                        test_pop_arr[index].store(*value, memory_order_seq_cst);
                     
-                    // Update sum
-                    sum.fetch_add(value, memory_order_seq_cst);
+                        // Update sum
+                        sum.fetch_add(*value, memory_order_seq_cst);
+                    }
                 }
-            }
-        }));
+            }));
+        }
     }
 
     // Wait for all threads
@@ -149,7 +540,7 @@ int tstack_test_advanced(int num_threads, vector<int>& arr) {
     // Verification checks
     
     // 1. Check if final stack is empty
-    if (mystack.pop() != -1) {
+    if (mystack.pop()) {
         cout << "Stack should be empty at this point" << endl;
         return -1;
     }
@@ -183,10 +574,111 @@ int tstack_test_advanced(int num_threads, vector<int>& arr) {
     write_back_to_file("Treiber_Push.txt", test_push_arr);
     write_back_to_file("Treiber_Pop.txt", test_pop_arr);
     
+    cout << "Peak RSS: " << peak_rss_kb() << " KB" << endl;
     cout << "Test passed successfully" << endl;
     return 0;
 }
 
+int tstack_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim, backoff_type backoff, int batch) {
+    if (tstack_test_basic() != 0)
+        return -1;
+    return with_reclaim(reclaim, [&]<class Reclaim>() {
+        return with_backoff(backoff, [&]<class Backoff>() {
+            return tstack_test_run<tstack<int, Reclaim, Backoff>>(num_threads, arr, batch);
+        });
+    });
+}
+
+int tagged_tstack_test_advanced(int num_threads, vector<int>& arr) {
+    return tstack_test_run<tagged_tstack<int>>(num_threads, arr);
+}
+
+template<class Stack>
+static double tstack_throughput(int num_threads, vector<int>& arr, int iters) {
+    Stack mystack;
+    return run_throughput(num_threads, arr, iters,
+                          [&](int v) { mystack.push(v); },
+                          [&]() { return mystack.pop().has_value(); });
+}
+
+// One row of the reclamation benchmark: throughput and peak RSS for the given scheme
+int tstack_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim) {
+    double ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        return tstack_throughput<tstack<int, Reclaim>>(num_threads, arr, iters);
+    });
+    cout << "| TREIBER_STACK | " << reclaim_name(reclaim) << " | " << num_threads << " | "
+         << (long)ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
+
+// One row of the backoff scaling benchmark
+int tstack_backoff_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim, backoff_type backoff) {
+    double ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        return with_backoff(backoff, [&]<class Backoff>() {
+            return tstack_throughput<tstack<int, Reclaim, Backoff>>(num_threads, arr, iters);
+        });
+    });
+    cout << "| TREIBER_STACK | " << backoff_name(backoff) << " | " << num_threads << " | "
+         << (long)ops << " |" << endl;
+    return 0;
+}
+
+// Throughput of push_range/pop_n per batch size, a batch of 1 uses push and pop
+int tstack_batch_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim) {
+    cout << "| Container | Reclamation | Batch | Threads | Ops/sec |" << endl;
+    cout << "|-----------|-------------|-------|---------|---------|" << endl;
+    for (int batch : {1, 4, 16, 64, 256}) {
+        double ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+            if (batch == 1)
+                return tstack_throughput<tstack<int, Reclaim>>(num_threads, arr, iters);
+            tstack<int, Reclaim> mystack;
+            return run_batch_throughput(num_threads, arr, iters, batch,
+                [&](auto first, auto last) { mystack.push_range(first, last); },
+                [&](size_t k, auto out) { return mystack.pop_n(k, out); });
+        });
+        cout << "| TREIBER_STACK | " << reclaim_name(reclaim) << " | " << batch << " | "
+             << num_threads << " | " << (long)ops << " |" << endl;
+    }
+    return 0;
+}
+
+// Tagged top stacks against the reclamation based ones, nodes are pooled in all of them
+int tstack_aba_bench(int num_threads, vector<int>& arr, int iters) {
+    cout << "| Container | ABA protection | Threads | Ops/sec |" << endl;
+    cout << "|-----------|----------------|---------|---------|" << endl;
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+    cout << "| TREIBER_STACK | 128 bit tagged top | " << num_threads << " | "
+         << (long)tstack_throughput<tagged_tstack<int, dwcas_top>>(num_threads, arr, iters) << " |" << endl;
+#endif
+    cout << "| TREIBER_STACK | 48+16 bit packed top | " << num_threads << " | "
+         << (long)tstack_throughput<tagged_tstack<int, packed_top>>(num_threads, arr, iters) << " |" << endl;
+    cout << "| TREIBER_STACK | hazard pointers | " << num_threads << " | "
+         << (long)tstack_throughput<tstack<int, hp_reclaim>>(num_threads, arr, iters) << " |" << endl;
+    cout << "| TREIBER_STACK | epochs | " << num_threads << " | "
+         << (long)tstack_throughput<tstack<int, ebr_reclaim>>(num_threads, arr, iters) << " |" << endl;
+    return 0;
+}
+
+// Idle CPU and wake-up latency of consumers polling pop() against consumers parked in pop_wait()
+int tstack_wait_bench(int num_threads, int rounds) {
+    for (bool parked : {false, true}) {
+        tstack<int> mystack;
+        wake_stats w = run_wake(num_threads, rounds,
+            [&](int v) { mystack.push(v); },
+            [&]() {
+                if (parked)
+                    return mystack.pop_wait(chrono::milliseconds(10));
+                optional<int> v = mystack.pop();
+                if (!v)
+                    this_thread::yield();
+                return v;
+            });
+        cout << "| TREIBER_STACK | " << (parked ? "pop_wait" : "poll") << " | " << num_threads << " | "
+             << (long)w.idle_cpu << " | " << w.p50 << " | " << w.max << " |" << endl;
+    }
+    return 0;
+}
+
 static void write_back_to_file(string out_file, vector<atomic<int>>& arr) {
     ofstream output_file_var(out_file);
 
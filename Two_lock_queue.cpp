@@ -0,0 +1,212 @@
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <optional>
+#include "common_header_file.h"
+#include "locks.h"
+#include "node_pool.h"
+#include "value_cell.h"
+#include "bench.h"
+
+using namespace std;
+
+// Two lock queue of Michael and Scott. Enqueuers serialize on the tail lock and dequeuers
+// on the head lock only, so one enqueue and one dequeue run in parallel. As in the lock free
+// queue the head is a dummy node: while the queue is empty head and tail are the same node
+// and its next pointer is the one word both sides touch, which is why it is atomic.
+// Lock is any BasicLockable, both locks are of that class.
+template<class T, class Lock = posix_mutex>
+class tlqueue {
+    class node : public pooled<node> {
+    public:
+        node() {}
+        template<class... Args>
+        node(Args&&... args) { val.construct(forward<Args>(args)...); }
+        value_cell<T> val;
+        atomic<node*> next{nullptr};
+    };
+
+private:
+    // Each lock sits on its own lines with the pointer it guards
+    alignas(CACHE_LINE_SIZE) Lock head_lock;
+    node* head;
+    alignas(CACHE_LINE_SIZE) Lock tail_lock;
+    node* tail;
+
+public:
+    tlqueue();
+    ~tlqueue();
+    // Constructs the value in place, the node is allocated outside the tail lock
+    template<class... Args>
+    void emplace(Args&&... args);
+    void enqueue(const T& val) { emplace(val); }
+    void enqueue(T&& val) { emplace(move(val)); }
+    // Moves the front value out, nullopt when the queue is empty
+    optional<T> dequeue();
+    // Prefills the node arena so the first n enqueues do not allocate from malloc
+    void reserve(size_t n) { node_pool<node>::instance().reserve(n); }
+};
+
+template<class T, class Lock>
+tlqueue<T, Lock>::tlqueue() {
+    head = tail = new node();
+}
+
+template<class T, class Lock>
+tlqueue<T, Lock>::~tlqueue() {
+    // The dummy at head holds no value, every node after it does
+    node* n = head;
+    bool is_dummy = true;
+    while (n != nullptr) {
+        node* next = n->next.load(memory_order_relaxed);
+        if (!is_dummy)
+            n->val.destroy();
+        delete n;
+        n = next;
+        is_dummy = false;
+    }
+}
+
+template<class T, class Lock>
+template<class... Args>
+void tlqueue<T, Lock>::emplace(Args&&... args) {
+    node* n = new node(forward<Args>(args)...);
+    lock_guard<Lock> lock(tail_lock);
+    tail->next.store(n, memory_order_release); // linearization point
+    tail = n;
+}
+
+template<class T, class Lock>
+optional<T> tlqueue<T, Lock>::dequeue() {
+    node* dummy;
+    optional<T> v;
+    {
+        lock_guard<Lock> lock(head_lock);
+        dummy = head;
+        node* first = dummy->next.load(memory_order_acquire);
+        if (first == nullptr)
+            return nullopt; // Queue is empty
+        first->val.move_to(v);
+        head = first; // first is the new dummy
+    }
+    // Enqueuers never touch a node once tail moved past it
+    delete dummy;
+    return v;
+}
+
+// This test is designed in such a way that multiple threads will execute the queue methods and
+// it is possible that for example during enqueue the sequence can be mistmatched with the values enqueued as in real time
+// threads can be executed in interleaved manner. So, to test, summing up the values enqueued should be equal to the sum of the values dequeued.
+template<class Lock>
+static int tlqueue_test_run(int num_threads, vector<int>& arr) {
+    int num_thread_for_each_ops = (num_threads / 2);
+
+    // Atomic counters for tracking
+    atomic<int> enqueue_counter(0);
+    atomic<int> dequeue_counter(0);
+
+    // Total sum tracking
+    atomic<long> sum(0);
+    long sum_actual = 0;
+
+    tlqueue<int, Lock> myqueue;
+    myqueue.reserve(num_thread_for_each_ops * arr.size());
+    vector<thread> local_threads;
+
+    // enqueue threads
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                myqueue.enqueue(arr[j]);
+                enqueue_counter.fetch_add(1, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // dequeue threads, retrying while the queue is empty
+    for (int i = 0; i < num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&]() {
+            for (size_t j = 0; j < arr.size(); j++) {
+                optional<int> value;
+                while (!(value = myqueue.dequeue()))
+                    this_thread::yield();
+                dequeue_counter.fetch_add(1, memory_order_seq_cst);
+                sum.fetch_add(*value, memory_order_seq_cst);
+            }
+        }));
+    }
+
+    // Wait for all threads
+    for (auto& t : local_threads) {
+        t.join();
+    }
+
+    // Calculate expected sum
+    for (size_t j = 0; j < arr.size(); j++) {
+        sum_actual += arr[j] * num_thread_for_each_ops;
+    }
+
+    // Verification checks
+
+    // 1. Check if final Queue is empty
+    if (myqueue.dequeue()) {
+        cout << "Queue should be empty at this point" << endl;
+        return -1;
+    }
+
+    // 2. Verify enqueue and dequeue counts
+    int expected_total_ops = num_thread_for_each_ops * arr.size();
+    int actual_enqueue_count = enqueue_counter.load(memory_order_seq_cst);
+    int actual_dequeue_count = dequeue_counter.load(memory_order_seq_cst);
+
+    cout << "Expected total operations: " << expected_total_ops << endl;
+    cout << "Actual enqueue count: " << actual_enqueue_count << endl;
+    cout << "Actual dequeue count: " << actual_dequeue_count << endl;
+
+    if (actual_enqueue_count != expected_total_ops) {
+        cout << "Enqueue count mismatch" << endl;
+        return -1;
+    }
+
+    if (actual_dequeue_count != expected_total_ops) {
+        cout << "Dequeue count mismatch" << endl;
+        return -1;
+    }
+
+    // 3. Verify sum
+    if (sum_actual != sum.load(memory_order_seq_cst)) {
+        cout << "Sum mismatch" << endl;
+        return -1;
+    }
+
+    cout << "Test passed successfully" << endl;
+    return 0;
+}
+
+// Peterson locks take two contenders, with them the test runs one enqueuer and one dequeuer
+int tlqueue_test_advanced(int num_threads, vector<int>& arr, locks_type lock) {
+    if (is_two_thread_lock(lock) && num_threads != 2) {
+        cout << "Peterson locks take two contenders, running with 2 threads" << endl;
+        num_threads = 2;
+    }
+    cout << "Lock: " << lock_name(lock) << endl;
+    return with_lock(lock, [&]<class Lock>() {
+        return tlqueue_test_run<Lock>(num_threads, arr);
+    });
+}
+
+// One row of the lock benchmark, Peterson locks always run with one producer and one consumer
+int tlqueue_lock_bench(int num_threads, vector<int>& arr, int iters, locks_type lock) {
+    if (is_two_thread_lock(lock))
+        num_threads = 2;
+    double ops = with_lock(lock, [&]<class Lock>() {
+        tlqueue<int, Lock> myqueue;
+        return run_throughput(num_threads, arr, iters,
+                              [&](int v) { myqueue.enqueue(v); },
+                              [&]() { return myqueue.dequeue().has_value(); });
+    });
+    cout << "| TWO_LOCK_QUEUE | " << lock_name(lock) << " | " << num_threads << " | "
+         << (long)ops << " |" << endl;
+    return 0;
+}
@@ -0,0 +1,150 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+typedef enum {
+    BACKOFF_NONE = 0,
+    BACKOFF_EXP,
+    BACKOFF_PAUSE,
+    BACKOFF_ADAPTIVE
+} backoff_type;
+
+// Spin limits of the backoff policies, in pause instructions.
+#define BACKOFF_MIN_SPINS 4
+#define BACKOFF_MAX_SPINS 4096
+
+// Pauses of the fixed pause spin after a failed CAS.
+#define BACKOFF_PAUSE_SPINS 32
+
+// Tells the core that this is a spin wait: no memory order speculation and the sibling
+// hyper thread gets the pipeline.
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+static inline void spin(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        cpu_relax();
+}
+
+// Per thread xorshift generator, so threads that failed together do not retry together.
+static inline uint32_t backoff_random() {
+    static thread_local uint32_t x = 0x9e3779b9u ^ (uint32_t)hash<thread::id>()(this_thread::get_id());
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Contention management policies used as template parameters of the containers.
+// Every operation creates one and calls fail() after each CAS it lost.
+
+// Baseline: retry the CAS at once.
+class no_backoff {
+public:
+    void fail() {}
+};
+
+// Waits a random number of pauses below a limit that doubles after every failure.
+class exp_backoff {
+private:
+    uint32_t limit = BACKOFF_MIN_SPINS;
+
+public:
+    void fail() {
+        spin(1 + backoff_random() % limit);
+        limit = min(limit * 2, (uint32_t)BACKOFF_MAX_SPINS);
+    }
+};
+
+// Fixed short pause spin, only keeps the retry from hammering the cache line.
+class pause_backoff {
+public:
+    void fail() { spin(BACKOFF_PAUSE_SPINS); }
+};
+
+// Exponential backoff whose starting limit follows the CAS failure rate the thread
+// observed over its recent operations: without contention it does not wait at all,
+// under heavy contention the first retry already waits long.
+class adaptive_backoff {
+private:
+    // Failures per operation in 1/256 units, averaged with a weight of 1/8
+    static uint32_t& failure_rate() {
+        static thread_local uint32_t rate = 0;
+        return rate;
+    }
+
+    uint32_t failures = 0;
+    uint32_t limit;
+
+public:
+    adaptive_backoff() {
+        uint32_t rate = failure_rate();
+        limit = BACKOFF_MIN_SPINS + (uint64_t)(BACKOFF_MAX_SPINS / 16) * rate / 1024;
+        if (limit > BACKOFF_MAX_SPINS)
+            limit = BACKOFF_MAX_SPINS;
+    }
+
+    ~adaptive_backoff() {
+        uint32_t& rate = failure_rate();
+        uint32_t sample = failures > 16 ? 16 * 256 : failures * 256;
+        rate = rate - rate / 8 + sample / 8;
+    }
+
+    void fail() {
+        // An isolated failure is retried at once
+        if (failures++ == 0 && failure_rate() < 64)
+            return;
+        spin(1 + backoff_random() % limit);
+        limit = min(limit * 2, (uint32_t)BACKOFF_MAX_SPINS);
+    }
+};
+
+// Calls f.template operator()<Policy>() with the policy matching the runtime choice,
+// same as with_reclaim.
+template<class F>
+auto with_backoff(backoff_type type, F&& f) {
+    switch (type) {
+        case BACKOFF_EXP:
+            return f.template operator()<exp_backoff>();
+        case BACKOFF_PAUSE:
+            return f.template operator()<pause_backoff>();
+        case BACKOFF_ADAPTIVE:
+            return f.template operator()<adaptive_backoff>();
+        case BACKOFF_NONE:
+        default:
+            return f.template operator()<no_backoff>();
+    }
+}
+
+static inline const char* backoff_name(backoff_type type) {
+    switch (type) {
+        case BACKOFF_EXP:
+            return "exponential";
+        case BACKOFF_PAUSE:
+            return "pause";
+        case BACKOFF_ADAPTIVE:
+            return "adaptive";
+        case BACKOFF_NONE:
+        default:
+            return "none";
+    }
+}
+
+#endif
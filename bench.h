@@ -0,0 +1,240 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace std;
+
+// Starts num_threads / 2 producer and num_threads / 2 consumer threads together and
+// returns the seconds until all of them finished.
+template<class Producer, class Consumer>
+double run_split(int num_threads, Producer producer, Consumer consumer) {
+    int num_thread_for_each_ops = max(num_threads / 2, 1);
+
+    atomic<int> ready(0);
+    atomic<bool> start(false);
+    vector<thread> local_threads;
+
+    for (int i = 0; i < 2 * num_thread_for_each_ops; i++) {
+        local_threads.push_back(thread([&, i]() {
+            ready.fetch_add(1);
+            while (!start.load(memory_order_acquire))
+                this_thread::yield();
+            if (i < num_thread_for_each_ops)
+                producer(i);
+            else
+                consumer(i - num_thread_for_each_ops);
+        }));
+    }
+
+    while (ready.load() != 2 * num_thread_for_each_ops)
+        this_thread::yield();
+
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    for (auto& t : local_threads)
+        t.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+    return elapsed.count();
+}
+
+// Throughput harness shared by the container benchmarks.
+// Half the threads push every value of arr iters times, the other half pop the same
+// number of values (retrying while the container is empty).
+// Returns the number of completed push + pop operations per second.
+template<class Push, class Pop>
+double run_throughput(int num_threads, vector<int>& arr, int iters, Push push, Pop pop) {
+    int num_thread_for_each_ops = max(num_threads / 2, 1);
+    long ops_per_thread = (long)arr.size() * iters;
+
+    double secs = run_split(num_threads,
+        [&](int) {
+            for (int k = 0; k < iters; k++)
+                for (size_t j = 0; j < arr.size(); j++)
+                    push(arr[j]);
+        },
+        [&](int) {
+            for (long j = 0; j < ops_per_thread; j++) {
+                while (!pop())
+                    this_thread::yield();
+            }
+        });
+
+    return (2.0 * num_thread_for_each_ops * ops_per_thread) / secs;
+}
+
+// Same split as run_throughput but every call moves up to batch values:
+// push_batch(first, last) pushes [first, last), pop_batch(k, out) pops up to k values
+// into out and returns how many it got.
+template<class PushBatch, class PopBatch>
+double run_batch_throughput(int num_threads, vector<int>& arr, int iters, int batch,
+                            PushBatch push_batch, PopBatch pop_batch) {
+    int num_thread_for_each_ops = max(num_threads / 2, 1);
+    long ops_per_thread = (long)arr.size() * iters;
+
+    double secs = run_split(num_threads,
+        [&](int) {
+            for (int k = 0; k < iters; k++)
+                for (size_t j = 0; j < arr.size(); j += batch)
+                    push_batch(arr.begin() + j, arr.begin() + min(arr.size(), j + batch));
+        },
+        [&](int) {
+            vector<int> values(batch);
+            for (long j = 0; j < ops_per_thread; ) {
+                size_t got = pop_batch(min<long>(batch, ops_per_thread - j), values.begin());
+                if (got == 0)
+                    this_thread::yield();
+                j += got;
+            }
+        });
+
+    return (2.0 * num_thread_for_each_ops * ops_per_thread) / secs;
+}
+
+class latency_stats {
+public:
+    long p50;
+    long p99;
+    long p999;
+    long max;
+};
+
+// Same split as run_throughput but every push and every successful pop is timed on its own.
+// push(tid, v) and pop(tid) get a thread id below num_threads: producers take the first
+// half, consumers the second. Returns percentiles over all timed operations in ns.
+template<class Push, class Pop>
+latency_stats run_latency(int num_threads, vector<int>& arr, int iters, Push push, Pop pop) {
+    int num_thread_for_each_ops = max(num_threads / 2, 1);
+    long ops_per_thread = (long)arr.size() * iters;
+    vector<vector<uint32_t>> samples(2 * num_thread_for_each_ops);
+
+    auto elapsed_ns = [](chrono::steady_clock::time_point begin) {
+        return (uint32_t)min<long>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - begin).count(), UINT32_MAX);
+    };
+
+    run_split(num_threads,
+        [&](int i) {
+            vector<uint32_t>& s = samples[i];
+            s.reserve(ops_per_thread);
+            for (int k = 0; k < iters; k++) {
+                for (size_t j = 0; j < arr.size(); j++) {
+                    auto begin = chrono::steady_clock::now();
+                    push(i, arr[j]);
+                    s.push_back(elapsed_ns(begin));
+                }
+            }
+        },
+        [&](int i) {
+            int tid = num_thread_for_each_ops + i;
+            vector<uint32_t>& s = samples[tid];
+            s.reserve(ops_per_thread);
+            for (long j = 0; j < ops_per_thread; j++) {
+                while (true) {
+                    auto begin = chrono::steady_clock::now();
+                    if (pop(tid)) {
+                        s.push_back(elapsed_ns(begin));
+                        break;
+                    }
+                    this_thread::yield();
+                }
+            }
+        });
+
+    vector<uint32_t> all;
+    for (auto& s : samples)
+        all.insert(all.end(), s.begin(), s.end());
+    sort(all.begin(), all.end());
+    auto at = [&](double q) { return (long)all[min(all.size() - 1, (size_t)(q * all.size()))]; };
+    return {at(0.5), at(0.99), at(0.999), (long)all.back()};
+}
+
+// User plus system CPU time of the process so far, in microseconds.
+static inline long cpu_time_us() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000L +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+class wake_stats {
+public:
+    double idle_cpu; // CPU time per wall time while nothing is pushed, in percent of a core
+    long p50;        // ns from the push to a consumer holding the value
+    long max;
+};
+
+// num_threads / 2 consumers wait on an empty container. For the first 200ms nothing is
+// pushed and the CPU time the process burns meanwhile is measured. Then one producer calls
+// push(v) rounds times, sleeping 1ms before each push so the consumers are idle again, and
+// every value is timed from just before its push until a consumer got it from pop().
+// pop() returns an optional and may return nullopt now and then so the consumers notice
+// the end of the run.
+template<class Push, class Pop>
+wake_stats run_wake(int num_threads, int rounds, Push push, Pop pop) {
+    int num_consumers = max(num_threads / 2, 1);
+    vector<atomic<long>> stamps(rounds);
+    vector<vector<uint32_t>> samples(num_consumers);
+    atomic<int> received(0);
+    atomic<bool> done(false);
+
+    auto now_ns = []() {
+        return (long)chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    };
+
+    vector<thread> consumers;
+    for (int i = 0; i < num_consumers; i++) {
+        consumers.push_back(thread([&, i]() {
+            while (!done.load(memory_order_acquire)) {
+                auto v = pop();
+                if (!v)
+                    continue;
+                samples[i].push_back((uint32_t)min<long>(now_ns() - stamps[*v].load(memory_order_acquire), UINT32_MAX));
+                received.fetch_add(1, memory_order_release);
+            }
+        }));
+    }
+
+    // Let the consumers reach their idle state before measuring
+    this_thread::sleep_for(chrono::milliseconds(20));
+    auto begin = chrono::steady_clock::now();
+    long cpu_begin = cpu_time_us();
+    this_thread::sleep_for(chrono::milliseconds(200));
+    long cpu_us = cpu_time_us() - cpu_begin;
+    long wall_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+
+    for (int v = 0; v < rounds; v++) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+        stamps[v].store(now_ns(), memory_order_release);
+        push(v);
+    }
+    while (received.load(memory_order_acquire) < rounds)
+        this_thread::yield();
+    done.store(true, memory_order_release);
+    for (auto& t : consumers)
+        t.join();
+
+    vector<uint32_t> all;
+    for (auto& s : samples)
+        all.insert(all.end(), s.begin(), s.end());
+    sort(all.begin(), all.end());
+    if (all.empty())
+        return {100.0 * cpu_us / wall_us, 0, 0};
+    return {100.0 * cpu_us / wall_us, (long)all[all.size() / 2], (long)all.back()};
+}
+
+// Peak resident set size of the process so far, in KB.
+static inline long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+#endif
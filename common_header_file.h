@@ -2,21 +2,64 @@
 #define COMMON_HEADER_FILE_H
 
 #include <vector>
+#include "reclamation.h"
+#include "backoff.h"
+#include "locks.h"
 
 using namespace std;
 
-int tstack_test_advanced(int num_threads, vector<int>&arr);
+int tstack_test_advanced(int num_threads, vector<int>&arr, reclaim_type reclaim, backoff_type backoff, int batch);
+int tstack_backoff_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim, backoff_type backoff);
+int tstack_batch_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim);
+int tstack_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim);
+int tagged_tstack_test_advanced(int num_threads, vector<int>& arr);
+int tstack_aba_bench(int num_threads, vector<int>& arr, int iters);
+int tstack_wait_bench(int num_threads, int rounds);
 
-int msqueue_test_advanced(int num_threads, vector<int>&arr);
+int msqueue_test_advanced(int num_threads, vector<int>&arr, reclaim_type reclaim, backoff_type backoff);
+int msqueue_backoff_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim, backoff_type backoff);
+int msqueue_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim);
+int msqueue_bench(int num_threads, vector<int>& arr, int iters);
+int msqueue_latency_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim);
+int msqueue_wait_bench(int num_threads, int rounds);
 
-int e_tstack_test_advanced(int num_threads, vector<int> &arr);
-void init_eli();
+int tlqueue_test_advanced(int num_threads, vector<int>& arr, locks_type lock);
+int tlqueue_lock_bench(int num_threads, vector<int>& arr, int iters, locks_type lock);
 
-int sgl_stack_test_advanced(int num_threads, vector<int>& arr);
+int faaqueue_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim);
+int faaqueue_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim);
 
-int e_sgl_stack_test_advanced(int num_threads, vector<int>& arr);
+int kpqueue_test_advanced(int num_threads, vector<int>& arr);
+int kpqueue_latency_bench(int num_threads, vector<int>& arr, int iters);
 
-int sgl_queue_test_advanced(int num_threads, vector<int>& arr);
+int mpmc_ring_test_advanced(int num_threads, vector<int>& arr, size_t capacity);
+int mpmc_ring_bench(int num_threads, vector<int>& arr, int iters, size_t capacity);
+
+int spsc_ring_test_advanced(int num_threads, vector<int>& arr, size_t capacity);
+int spsc_ring_bench(vector<int>& arr, int iters, size_t capacity);
+
+int intrusive_tstack_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim);
+int intrusive_msqueue_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim);
+int intrusive_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim);
+
+int e_tstack_test_advanced(int num_threads, vector<int> &arr, reclaim_type reclaim, long wait_ns);
+int e_tstack_latency_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim, long wait_ns);
+int elimination_bench(int num_threads, int iters, long wait_ns);
+
+int sgl_stack_test_advanced(int num_threads, vector<int>& arr, int shards, locks_type lock);
+
+int e_sgl_stack_test_advanced(int num_threads, vector<int>& arr, long wait_ns);
+
+int sgl_queue_test_advanced(int num_threads, vector<int>& arr, int shards, locks_type lock);
+int sgl_queue_bench(int num_threads, vector<int>& arr, int iters);
+int sgl_queue_depth_bench(int num_threads, vector<int>& arr, int iters);
+int sgl_shards_bench(int num_threads, vector<int>& arr, int iters);
+int sgl_lock_bench(int num_threads, vector<int>& arr, int iters, locks_type only, bool only_given);
+int lock_dispatch_bench(int num_threads, vector<int>& arr, int iters, locks_type only, bool only_given);
+
+int queue_lock_bench(int num_threads, int iters, locks_type only, bool only_given);
+int oversubscription_bench(int iters, locks_type only, bool only_given);
+int barrier_bench(int num_threads, int iters);
 
 int fc_stack_test_advanced(int num_threads, vector<int>& arr);
 int fc_queue_test_advanced(int num_threads, vector<int>&arr);
@@ -7,6 +7,11 @@
 #include <mutex>
 #include <cassert>
 #include <fstream>
+#include "common_header_file.h"
+#include "reclamation.h"
+#include "node_pool.h"
+#include "bench.h"
+#include "locks.h"
 
 using namespace std;
 
@@ -15,10 +20,21 @@ static void write_back_to_file(string out_file, vector<atomic<int>>& arr);
 // Thread-safe random number generator
 thread_local std::mt19937 generator(std::random_device{}());
 
-// Node for the lock-free stack
+// The containers of this file are local to it, Treiber_Stack.cpp and SGL.cpp have their own
+namespace {
+
+// Slots of the elimination array of a container shared by num_threads threads: one per
+// pusher and popper pair
+static int elimination_slots(int num_threads) {
+    return max(num_threads / 2, 1);
+}
+
+// Node for the lock-free stack. A push or pop that lost its CAS tries to meet its
+// counterpart in the stack's own elimination array Eli, waiting at most budget there.
+template<class Reclaim, class Eli>
 class tstack {
 public:
-    class node {
+    class node : public pooled<node> {
     public:
         atomic<int> val;
         atomic<node*> down;
@@ -31,13 +47,23 @@ public:
 
 private:
     atomic<node*> top = nullptr;
+    Eli eli;
+    typename Eli::budget_type budget;
 
 public:
+    tstack(int num_threads, typename Eli::budget_type budget)
+        : eli(elimination_slots(num_threads), num_threads), budget(budget) {}
+    ~tstack();
+    Eli& elimination() { return eli; }
     void elimination_tstack_push(int val);
     int elimination_tstack_pop();
+    // Prefills the node arena so the first n pushes do not allocate from malloc
+    void reserve(size_t n) { node_pool<node>::instance().reserve(n); }
 };
 
-// Global elimination array class
+// Elimination slot of the first version, kept as the baseline of -b elimination: state and
+// value are three separate words, so a pusher and a popper can see each other's half written
+// state, and neighbouring slots share cache lines
 class slot_class {
 public:
     atomic<bool> is_available;
@@ -53,7 +79,12 @@ private:
     int size;
 
 public:
-    e_class(int size_array) : size(size_array), e_array(size_array) {}
+    // Timeout in clock() ticks, the pusher also sleeps that many ms
+    using budget_type = int;
+
+    // The three word slots keep no per thread state, num_threads is only taken for the
+    // same constructor as elimination_array
+    e_class(int size_array, int num_threads) : size(size_array), e_array(size_array) {}
 
     void init_elimination() {
         for (int i = 0; i < size; i++) {
@@ -66,22 +97,135 @@ public:
     bool elimination(int& val, bool is_push_ops, int timeout_ms);
 };
 
-// Spin-lock stack with elimination support
+// Elimination slot as one 64 bit word on its own cache line: the state in the upper half and
+// the offered value in the lower one. A pusher moves it from EMPTY to WAITING with its value,
+// a popper takes the value by moving it from WAITING to BUSY, and the pusher sets it EMPTY
+// again once it saw BUSY or withdrew the offer. Every transition is a single CAS or store.
+class alignas(CACHE_LINE_SIZE) exchanger {
+private:
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t WAITING = 1;
+    static constexpr uint64_t BUSY = 2;
+    atomic<uint64_t> word{0};
+
+    static uint64_t pack(uint64_t state, int val) { return state << 32 | (uint32_t)val; }
+    static uint64_t state_of(uint64_t w) { return w >> 32; }
+
+public:
+    // done: the value changed hands, collided: the slot was taken by another thread of the
+    // same side or the CAS was lost, missed: no partner (timeout, or no pusher waiting)
+    enum result { done, collided, missed };
+
+    // Offers val until a popper took it or the deadline passed
+    result offer(int val, chrono::steady_clock::time_point deadline) {
+        uint64_t expected = pack(EMPTY, 0);
+        uint64_t offered = pack(WAITING, val);
+        if (!word.compare_exchange_strong(expected, offered, memory_order_acq_rel))
+            return collided;
+        pause_yield_spin spin;
+        while (chrono::steady_clock::now() < deadline) {
+            if (state_of(word.load(memory_order_acquire)) == BUSY) {
+                word.store(pack(EMPTY, 0), memory_order_release);
+                return done;
+            }
+            spin.wait();
+        }
+        // Withdraw the offer, unless a popper took it in the meantime
+        if (word.compare_exchange_strong(offered, pack(EMPTY, 0), memory_order_acq_rel))
+            return missed;
+        word.store(pack(EMPTY, 0), memory_order_release);
+        return done;
+    }
+
+    // Takes the value of a waiting pusher
+    result take(int& val) {
+        uint64_t w = word.load(memory_order_acquire);
+        if (state_of(w) == EMPTY)
+            return missed;
+        if (state_of(w) != WAITING || !word.compare_exchange_strong(w, pack(BUSY, 0), memory_order_acq_rel))
+            return collided;
+        val = (int)(uint32_t)w;
+        return done;
+    }
+
+    void reset() { word.store(pack(EMPTY, 0), memory_order_relaxed); }
+};
+
+class elimination_stats {
+public:
+    long hits;       // Calls that exchanged a value
+    long timeouts;   // Calls that gave up after their budget
+    long collisions; // Slots found taken by the same side
+};
+
+// With adaptive ranges (Hendler, Shavit and Yerushalmi) every thread only picks slots below its
+// own range: a collision doubles the range, spreading the threads out, and a timeout halves
+// it, so that few threads gather on few slots where they can meet. The ranges live in the
+// array, one per thread it is built for, indexed by thread number: a thread using several
+// stacks adapts to each. Without, every slot of the array is a candidate.
+class elimination_array {
+    // Range of one thread on its own line. Threads whose numbers are equal modulo the thread
+    // count share it, hence atomic.
+    class alignas(CACHE_LINE_SIZE) thread_range {
+    public:
+        atomic<int> r{1};
+    };
+
+private:
+    vector<exchanger> e_array;
+    int size;
+    bool adaptive;
+    vector<thread_range> ranges;
+    alignas(CACHE_LINE_SIZE) atomic<long> hits{0};
+    atomic<long> timeouts{0};
+    atomic<long> collisions{0};
+
+public:
+    // Time a push or pop spends in the array before it goes back to the container
+    using budget_type = chrono::nanoseconds;
+
+    elimination_array(int size_array, int num_threads, bool adaptive_range = true)
+        : e_array(size_array), size(size_array), adaptive(adaptive_range),
+          ranges(max(num_threads, 1)) {}
+
+    void init_elimination() {
+        for (int i = 0; i < size; i++)
+            e_array[i].reset();
+        for (thread_range& t : ranges)
+            t.r.store(1, memory_order_relaxed);
+        hits.store(0, memory_order_relaxed);
+        timeouts.store(0, memory_order_relaxed);
+        collisions.store(0, memory_order_relaxed);
+    }
+
+    elimination_stats stats() const {
+        return {hits.load(memory_order_relaxed), timeouts.load(memory_order_relaxed),
+                collisions.load(memory_order_relaxed)};
+    }
+
+    // Exchanges val with a popper (is_push_ops) or takes a pusher's value into val, true once
+    // that happened within budget
+    bool elimination(int& val, bool is_push_ops, budget_type budget);
+};
+
+// Spin-lock stack with elimination support, a push or pop that found the lock taken goes
+// to the stack's own elimination array Eli
+template<class Eli = elimination_array>
 class sgl {
 private:
     vector<int> arr;
     mutex sgl_eli_lock;
+    Eli eli;
+    typename Eli::budget_type budget;
 
 public:
+    sgl(int num_threads, typename Eli::budget_type budget)
+        : eli(elimination_slots(num_threads), num_threads), budget(budget) {}
+    Eli& elimination() { return eli; }
     void sgl_eli_push_stack(int val);
     int sgl_eli_pop_stack();
 };
 
-// Global elimination array instance
-e_class eli(1000);
-
-void init_eli() {
-    eli.init_elimination();
 }
 
 // Elimination function
@@ -121,8 +265,46 @@ bool e_class::elimination(int& val, bool is_push_ops, int timeout_ms) {
     return false;
 }
 
+// Tries random slots until the timeout: a pusher offers its value in an empty slot and waits
+// there for a popper, a popper takes the value of a waiting pusher
+bool elimination_array::elimination(int& val, bool is_push_ops, budget_type budget) {
+    atomic<int>& range = ranges[thread_number() % ranges.size()].r;
+    int r = range.load(memory_order_relaxed);
+    auto deadline = chrono::steady_clock::now() + budget;
+    pause_yield_spin spin;
+    while (chrono::steady_clock::now() < deadline) {
+        std::uniform_int_distribution<int> distribution(0, (adaptive ? r : size) - 1);
+        exchanger& slot = e_array[distribution(generator)];
+        exchanger::result res = is_push_ops ? slot.offer(val, deadline) : slot.take(val);
+        if (res == exchanger::done) {
+            hits.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        if (res == exchanger::collided) {
+            collisions.fetch_add(1, memory_order_relaxed);
+            r = min(2 * r, size);
+            range.store(r, memory_order_relaxed);
+        }
+        spin.wait();
+    }
+    timeouts.fetch_add(1, memory_order_relaxed);
+    range.store(max(r / 2, 1), memory_order_relaxed);
+    return false;
+}
+
+template<class Reclaim, class Eli>
+tstack<Reclaim, Eli>::~tstack() {
+    node* t = top.load(memory_order_acquire);
+    while (t != nullptr) {
+        node* n = t->down.load(memory_order_relaxed);
+        delete t;
+        t = n;
+    }
+}
+
 // Lock-free stack push with retry logic
-void tstack::elimination_tstack_push(int val) {
+template<class Reclaim, class Eli>
+void tstack<Reclaim, Eli>::elimination_tstack_push(int val) {
     node* n = new node(val);
     node* t;
     while (true) {
@@ -132,36 +314,40 @@ void tstack::elimination_tstack_push(int val) {
             return;
         } else {
             // Elimination retry mechanism
-            if (!eli.elimination(val, true, 200)) {
+            if (!eli.elimination(val, true, budget)) {
                 continue;
             }
+            delete n; // Never published, the value went to a popper
             return;
         }
     }
 }
 
 // Lock-free stack pop with retry logic
-int tstack::elimination_tstack_pop() {
+template<class Reclaim, class Eli>
+int tstack<Reclaim, Eli>::elimination_tstack_pop() {
+    typename Reclaim::guard g;
     node* t;
     node* n;
     int v;
 
     while (true) {
-        t = top.load(memory_order_acquire);
+        t = g.protect(0, top);
         if (t == nullptr) {
             return -1;  // Stack is empty, handle it by returning -1
         }
 
         n = t->down.load(memory_order_acquire);
-        v = t->val.load(memory_order_acquire);
 
         // Try to pop the top of the stack
         if (top.compare_exchange_strong(t, n, memory_order_acq_rel)) {
-            delete t;  // Free the popped node
+            v = t->val.load(memory_order_acquire);
+            g.clear(0);
+            Reclaim::retire(t);  // Freed once no other popper can still be reading t->down
             return v;
         } else {
             // Elimination retry mechanism
-            if (!eli.elimination(v, false, 200)) {
+            if (!eli.elimination(v, false, budget)) {
                 // Retry if elimination fails
                 continue;
             } else {
@@ -173,7 +359,8 @@ int tstack::elimination_tstack_pop() {
 }
 
 // Spin-lock stack push with retry logic
-void sgl::sgl_eli_push_stack(int val) {
+template<class Eli>
+void sgl<Eli>::sgl_eli_push_stack(int val) {
     while (true) {
         if (sgl_eli_lock.try_lock()) {
             arr.push_back(val);
@@ -181,7 +368,7 @@ void sgl::sgl_eli_push_stack(int val) {
             return;
         } else {
             // Elimination retry mechanism
-            if (!eli.elimination(val, true, 1000)) {
+            if (!eli.elimination(val, true, budget)) {
                 continue;
             }
             return;
@@ -190,7 +377,8 @@ void sgl::sgl_eli_push_stack(int val) {
 }
 
 // Spin-lock stack pop with retry logic
-int sgl::sgl_eli_pop_stack() {
+template<class Eli>
+int sgl<Eli>::sgl_eli_pop_stack() {
     int val = 0;
     while (true) {
         if (sgl_eli_lock.try_lock()) {
@@ -204,7 +392,7 @@ int sgl::sgl_eli_pop_stack() {
             return val;
         } else {
             // Elimination retry mechanism
-            if (!eli.elimination(val, false, 1000)) {
+            if (!eli.elimination(val, false, budget)) {
                 continue;
             }
             return val;
@@ -212,7 +400,8 @@ int sgl::sgl_eli_pop_stack() {
     }
 }
 
-int e_tstack_test_advanced(int num_threads, vector<int>& arr) {
+template<class Reclaim>
+static int e_tstack_test_run(int num_threads, vector<int>& arr, long wait_ns) {
     int num_thread_for_each_ops = num_threads / 2;
 
     vector<atomic<int>> test_push_arr(num_thread_for_each_ops * arr.size());
@@ -225,7 +414,8 @@ int e_tstack_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
 
-    tstack mystack;
+    tstack<Reclaim, elimination_array> mystack(num_threads, chrono::nanoseconds(wait_ns));
+    mystack.reserve(num_thread_for_each_ops * arr.size());
     vector<thread> local_threads;
 
     // Push threads
@@ -307,11 +497,21 @@ int e_tstack_test_advanced(int num_threads, vector<int>& arr) {
     write_back_to_file("Eli_Treiber_Push.txt", test_push_arr);
     write_back_to_file("Eli_Treiber_Pop.txt", test_pop_arr);
 
+    elimination_stats st = mystack.elimination().stats();
+    cout << "Elimination: " << st.hits << " hits, " << st.timeouts << " timeouts, "
+         << st.collisions << " collisions" << endl;
+    cout << "Peak RSS: " << peak_rss_kb() << " KB" << endl;
     cout << "Test passed successfully" << endl;
     return 0;
 }
 
-int e_sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
+int e_tstack_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim, long wait_ns) {
+    return with_reclaim(reclaim, [&]<class Reclaim>() {
+        return e_tstack_test_run<Reclaim>(num_threads, arr, wait_ns);
+    });
+}
+
+int e_sgl_stack_test_advanced(int num_threads, vector<int>& arr, long wait_ns) {
     int num_thread_for_each_ops = (num_threads / 2);
 
     vector<atomic<int>> test_push_arr(num_thread_for_each_ops * arr.size());
@@ -324,7 +524,7 @@ int e_sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
 
-    sgl mystack;
+    sgl<> mystack(num_threads, chrono::nanoseconds(wait_ns));
     vector<thread> local_threads;
 
     // Push threads
@@ -405,11 +605,14 @@ int e_sgl_stack_test_advanced(int num_threads, vector<int>& arr) {
     write_back_to_file("Eli_SGL_Push.txt", test_push_arr);
     write_back_to_file("Eli_SGL_Pop.txt", test_pop_arr);
 
+    elimination_stats st = mystack.elimination().stats();
+    cout << "Elimination: " << st.hits << " hits, " << st.timeouts << " timeouts, "
+         << st.collisions << " collisions" << endl;
     cout << "Test passed successfully" << endl;
     return 0;
 }
 
-void write_back_to_file(string out_file, vector<atomic<int>>& arr) {
+static void write_back_to_file(string out_file, vector<atomic<int>>& arr) {
     ofstream file(out_file);
     for (size_t i = 0; i < arr.size(); i++) {
         file << arr[i].load() << " ";
@@ -417,3 +620,101 @@ void write_back_to_file(string out_file, vector<atomic<int>>& arr) {
     file << endl;
     file.close();
 }
+
+// Half the threads offer rounds values to the elimination array, the other half try rounds
+// times to take one, every attempt with the given budget. Prints the share of pushes that
+// met a popper, the exchanges per second and whether the values taken add up to the values
+// handed over.
+template<class Array>
+static void elimination_row(const char* name, int num_threads, int slots, int rounds,
+                            typename Array::budget_type budget) {
+    Array array(slots, num_threads);
+    atomic<long> pushed_sum(0), popped_sum(0);
+    atomic<long> exchanges(0);
+    double secs = run_split(num_threads,
+        [&](int) {
+            for (int r = 1; r <= rounds; r++) {
+                int v = r;
+                if (array.elimination(v, true, budget)) {
+                    pushed_sum.fetch_add(r, memory_order_relaxed);
+                    exchanges.fetch_add(1, memory_order_relaxed);
+                }
+            }
+        },
+        [&](int) {
+            for (int r = 0; r < rounds; r++) {
+                int v = 0;
+                if (array.elimination(v, false, budget))
+                    popped_sum.fetch_add(v, memory_order_relaxed);
+            }
+        });
+    long attempts = (long)max(num_threads / 2, 1) * rounds;
+    cout << "| " << name << " | " << num_threads << " | " << slots << " | " << attempts << " | "
+         << 100.0 * exchanges.load() / attempts << " | " << (long)(exchanges.load() / secs) << " | "
+         << (pushed_sum.load() == popped_sum.load() ? "yes" : "no") << " |" << endl;
+}
+
+// Single word exchangers with the -w budget against the three word slots with the old
+// timeout of the Treiber stack (200 clock ticks), with one slot per pusher as in the stacks and
+// with 1000 slots. A three word pusher sleeps for 200 ms once it has a slot, so it only
+// gets min(iters, 10) attempts per thread. Then the hit and miss counters of the exchangers
+// with and without adaptive ranges at 2, 4, 8, ... up to num_threads threads.
+int elimination_bench(int num_threads, int iters, long wait_ns) {
+    cout << "| Slots | Threads | Array size | Push attempts | Pushes eliminated (%) | Exchanges/sec | Values match |" << endl;
+    cout << "|-------|---------|------------|---------------|-----------------------|---------------|--------------|" << endl;
+    for (int slots : {elimination_slots(num_threads), 1000}) {
+        elimination_row<e_class>("three_word", num_threads, slots, min(iters, 10), 200);
+        elimination_row<elimination_array>("exchanger", num_threads, slots, iters, chrono::nanoseconds(wait_ns));
+    }
+
+    // Whole array against adaptive ranges on 1000 slots, per thread count
+    cout << endl;
+    cout << "| Range | Threads | Hits | Timeouts | Collisions | Calls eliminated (%) |" << endl;
+    cout << "|-------|---------|------|----------|------------|----------------------|" << endl;
+    for (int t = 2; t <= max(num_threads, 2); t *= 2) {
+        for (bool adaptive : {false, true}) {
+            elimination_array array(1000, t, adaptive);
+            run_split(t,
+                [&](int) {
+                    for (int r = 1; r <= iters; r++) {
+                        int v = r;
+                        array.elimination(v, true, chrono::nanoseconds(wait_ns));
+                    }
+                },
+                [&](int) {
+                    for (int r = 0; r < iters; r++) {
+                        int v = 0;
+                        array.elimination(v, false, chrono::nanoseconds(wait_ns));
+                    }
+                });
+            elimination_stats st = array.stats();
+            cout << "| " << (adaptive ? "adaptive" : "whole array") << " | " << t << " | " << st.hits << " | "
+                 << st.timeouts << " | " << st.collisions << " | "
+                 << 100.0 * st.hits / max(st.hits + st.timeouts, 1L) << " |" << endl;
+        }
+    }
+    return 0;
+}
+
+// Push and pop latency of the elimination Treiber stack with the old waiting (200 clock
+// ticks of process CPU time, then a 200 ms sleep of the pusher) against the bounded spin of
+// wait_ns on the steady clock
+int e_tstack_latency_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim, long wait_ns) {
+    cout << "| Elimination wait | Threads | p50 (ns) | p99 (ns) | p99.9 (ns) | max (ns) |" << endl;
+    cout << "|------------------|---------|----------|----------|------------|----------|" << endl;
+    with_reclaim(reclaim, [&]<class Reclaim>() {
+        auto row = [&]<class Eli>(const char* name, typename Eli::budget_type budget) {
+            tstack<Reclaim, Eli> mystack(num_threads, budget);
+            latency_stats l = run_latency(num_threads, arr, iters,
+                                          [&](int, int v) { mystack.elimination_tstack_push(v); },
+                                          [&](int) { return mystack.elimination_tstack_pop() != -1; });
+            cout << "| " << name << " | " << num_threads << " | " << l.p50 << " | " << l.p99 << " | "
+                 << l.p999 << " | " << l.max << " |" << endl;
+        };
+        row.template operator()<e_class>("clock() + sleep_for 200", 200);
+        string spin_name = "spin " + to_string(wait_ns) + " ns";
+        row.template operator()<elimination_array>(spin_name.c_str(), chrono::nanoseconds(wait_ns));
+        return 0;
+    });
+    return 0;
+}
@@ -0,0 +1,107 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Lets consumers of a lock free container sleep until a producer adds an item, without a
+// mutex on either side.
+// A consumer registers itself with prepare_wait(), checks the container once more and only
+// then sleeps on the epoch word with a futex. A producer calls notify() after the seq_cst
+// operation that published its item; it reads the waiter count and only when someone is
+// parked bumps the epoch and enters the kernel. With no parked consumer a push therefore
+// stays its one atomic plus a plain load.
+// Like the condition in SpuriousCondVar, a woken consumer never trusts the wakeup: it
+// retries the container and parks again if the item was taken by someone else.
+class eventcount {
+private:
+    atomic<uint32_t> epoch{0};
+    atomic<uint32_t> waiters{0};
+
+    static long futex(atomic<uint32_t>* addr, int op, uint32_t val, const timespec* timeout) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, timeout, nullptr, 0);
+    }
+
+public:
+    // Producer side. The publishing operation must be seq_cst so that either it is visible
+    // to the consumer's check after prepare_wait() or the consumer's registration is
+    // visible here.
+    void notify() {
+        if (waiters.load(memory_order_seq_cst) == 0)
+            return;
+        epoch.fetch_add(1, memory_order_acq_rel);
+        // Every parked consumer rechecks, one that times out cannot swallow the wakeup
+        futex(&epoch, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+    }
+
+    // Consumer side: registers as waiter and returns the key to pass to wait()
+    uint32_t prepare_wait() {
+        waiters.fetch_add(1, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);
+        return epoch.load(memory_order_acquire);
+    }
+
+    // The recheck after prepare_wait() found an item
+    void cancel_wait() { waiters.fetch_sub(1, memory_order_release); }
+
+    // Sleeps until notify() was called after prepare_wait() returned key or until the
+    // deadline passes. Returns false on timeout.
+    bool wait(uint32_t key, chrono::steady_clock::time_point deadline) {
+        bool notified = true;
+        while (epoch.load(memory_order_acquire) == key) {
+            timespec ts;
+            timespec* timeout = nullptr;
+            if (deadline != chrono::steady_clock::time_point::max()) {
+                auto left = chrono::duration_cast<chrono::nanoseconds>(deadline - chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    notified = false;
+                    break;
+                }
+                ts.tv_sec = left / 1000000000;
+                ts.tv_nsec = left % 1000000000;
+                timeout = &ts;
+            }
+            // Returns at once if the epoch already moved on; EINTR and spurious returns
+            // simply go round the loop again
+            futex(&epoch, FUTEX_WAIT_PRIVATE, key, timeout);
+        }
+        waiters.fetch_sub(1, memory_order_release);
+        return notified;
+    }
+};
+
+// Blocking pop built on try_pop(): returns its first value, or nullopt once the timeout
+// expired with the container still empty.
+template<class TryPop>
+auto wait_for_item(eventcount& ec, chrono::nanoseconds timeout, TryPop try_pop) -> decltype(try_pop()) {
+    auto deadline = chrono::steady_clock::time_point::max();
+    if (timeout != chrono::nanoseconds::max())
+        deadline = chrono::steady_clock::now() + timeout;
+
+    while (true) {
+        auto v = try_pop();
+        if (v)
+            return v;
+
+        uint32_t key = ec.prepare_wait();
+        v = try_pop();
+        if (v) {
+            ec.cancel_wait();
+            return v;
+        }
+        if (!ec.wait(key, deadline))
+            return try_pop(); // Last look on timeout
+    }
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <deque>
 #include <fstream>
 #include <cassert>
+#include <optional>
 
 using namespace std;
 
@@ -18,19 +19,26 @@ enum OperationType {
     DEQUEUE
 };
 
+template<class T>
 class FC {
 private:
-    vector<int> data; // For stack operations
+    vector<T> data; // For stack operations
+    // A request slot. The owner fills value and then sets ready; the combiner only looks at
+    // ready slots and publishes result through completed.
     struct FlatCombinedStructure {
         OperationType type;
+        atomic<bool> ready{false};
         atomic<bool> completed{false};
-        atomic<int> result{0};
-        atomic<int> value{0};
+        optional<T> result;
+        optional<T> value;
     };
 
     atomic<int> index{0};
     vector<FlatCombinedStructure> ops;
 
+    FlatCombinedStructure& publish(OperationType type);
+    optional<T> wait_for(FlatCombinedStructure& op);
+
 public:
     condition_variable cv;
     mutex fc_mutex;
@@ -38,47 +46,42 @@ public:
     FC() : ops(100000) {}
 
     void flat_combine();
-    void push_stack(int val);
-    int pop_stack();
-    void enqueue_queue(int val);
-    int dequeue_queue();
+    template<class... Args>
+    void emplace_stack(Args&&... args);
+    void push_stack(T val) { emplace_stack(move(val)); }
+    optional<T> pop_stack();
+    template<class... Args>
+    void emplace_queue(Args&&... args);
+    void enqueue_queue(T val) { emplace_queue(move(val)); }
+    optional<T> dequeue_queue();
 };
 
-void FC::flat_combine() {
+template<class T>
+void FC<T>::flat_combine() {
     for (int i = 0; i < index.load(memory_order_acquire); ++i) {
         auto& op = ops[i];
 
-        if (op.completed.load(memory_order_acquire)) continue;
+        if (!op.ready.load(memory_order_acquire) || op.completed.load(memory_order_acquire)) continue;
 
         switch (op.type) {
             case PUSH:
-                data.push_back(op.value.load(memory_order_acquire));
-                op.result.store(1, memory_order_release); // Indicate success
+            case ENQUEUE:
+                data.push_back(move(*op.value));
+                op.value.reset();
                 break;
 
             case POP:
                 if (!data.empty()) {
-                    int popped_value = data.back();
+                    op.result.emplace(move(data.back()));
                     data.pop_back();
-                    op.result.store(popped_value, memory_order_release);
-                } else {
-                    op.result.store(-1, memory_order_release); // Stack empty
-                }
-                break;
-                
-            case ENQUEUE:
-                data.push_back(op.value.load(memory_order_acquire));
-                op.result.store(1, memory_order_release); // Indicate success
+                } // otherwise result stays empty, the stack is empty
                 break;
 
             case DEQUEUE:
                 if (!data.empty()) {
-                    int popped_value = data.front();
+                    op.result.emplace(move(data.front()));
                     data.erase(data.begin());
-                    op.result.store(popped_value, memory_order_release);
-                } else {
-                    op.result.store(-1, memory_order_release); // Stack empty
-                }
+                } // otherwise result stays empty, the queue is empty
                 break;                
         }
 
@@ -87,58 +90,49 @@ void FC::flat_combine() {
     cv.notify_all();
 }
 
-void FC::push_stack(int val) {
+template<class T>
+typename FC<T>::FlatCombinedStructure& FC<T>::publish(OperationType type) {
     int current_index = index.fetch_add(1, memory_order_seq_cst);
     auto& new_op = ops[current_index];
-
-    new_op.type = PUSH;
-    new_op.value.store(val, memory_order_relaxed);
-    new_op.completed.store(false, memory_order_relaxed);
-
-    unique_lock<mutex> lock(fc_mutex);
-    flat_combine();
-    cv.wait(lock, [&new_op] { return new_op.completed.load(memory_order_acquire); });
+    new_op.type = type;
+    return new_op;
 }
 
-int FC::pop_stack() {
-    int current_index = index.fetch_add(1, memory_order_seq_cst);
-    auto& new_op = ops[current_index];
-
-    new_op.type = POP;
-    new_op.completed.store(false, memory_order_relaxed);
+template<class T>
+optional<T> FC<T>::wait_for(FlatCombinedStructure& op) {
+    op.ready.store(true, memory_order_release);
 
     unique_lock<mutex> lock(fc_mutex);
     flat_combine();
-    cv.wait(lock, [&new_op] { return new_op.completed.load(memory_order_acquire); });
+    cv.wait(lock, [&op] { return op.completed.load(memory_order_acquire); });
 
-    return new_op.result.load(memory_order_acquire);
+    return move(op.result);
 }
 
-void FC::enqueue_queue(int val) {
-    int current_index = index.fetch_add(1, memory_order_seq_cst);
-    auto& new_op = ops[current_index];
-
-    new_op.type = ENQUEUE;
-    new_op.value.store(val, memory_order_relaxed);
-    new_op.completed.store(false, memory_order_relaxed);
-
-    unique_lock<mutex> lock(fc_mutex);
-    flat_combine();
-    cv.wait(lock, [&new_op] { return new_op.completed.load(memory_order_acquire); });
+template<class T>
+template<class... Args>
+void FC<T>::emplace_stack(Args&&... args) {
+    auto& new_op = publish(PUSH);
+    new_op.value.emplace(forward<Args>(args)...);
+    wait_for(new_op);
 }
 
-int FC::dequeue_queue() {
-    int current_index = index.fetch_add(1, memory_order_seq_cst);
-    auto& new_op = ops[current_index];
-
-    new_op.type = DEQUEUE;
-    new_op.completed.store(false, memory_order_relaxed);
+template<class T>
+optional<T> FC<T>::pop_stack() {
+    return wait_for(publish(POP));
+}
 
-    unique_lock<mutex> lock(fc_mutex);
-    flat_combine();
-    cv.wait(lock, [&new_op] { return new_op.completed.load(memory_order_acquire); });
+template<class T>
+template<class... Args>
+void FC<T>::emplace_queue(Args&&... args) {
+    auto& new_op = publish(ENQUEUE);
+    new_op.value.emplace(forward<Args>(args)...);
+    wait_for(new_op);
+}
 
-    return new_op.result.load(memory_order_acquire);
+template<class T>
+optional<T> FC<T>::dequeue_queue() {
+    return wait_for(publish(DEQUEUE));
 }
 
 static void write_back_to_file(const string& out_file, vector<atomic<int>>& arr, int size) {
@@ -172,7 +166,7 @@ int fc_stack_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
     
-    FC mystack;
+    FC<int> mystack;
     vector<thread> local_threads;
 
     // Push threads
@@ -196,20 +190,20 @@ int fc_stack_test_advanced(int num_threads, vector<int>& arr) {
     for (int i = 0; i < num_thread_for_each_ops; i++) {
         local_threads.push_back(thread([&, i]() {
             for (int j = 0; j < arr.size(); j++) {
-                int value = mystack.pop_stack();
+                optional<int> value = mystack.pop_stack();
                 
                 // Only process valid pop values
-                if (value != -1) {
+                if (value) {
                     // Track pop operation
                     int pop_index = pop_counter.fetch_add(1, memory_order_seq_cst);
                     assert(pop_index < test_pop_arr.size());
                     
                     // Store popped value
                     int index = i * arr.size() + j;
-                    test_pop_arr[index].store(value, memory_order_seq_cst);
+                    test_pop_arr[index].store(*value, memory_order_seq_cst);
                     
                     // Update sum
-                    sum.fetch_add(value, memory_order_seq_cst);
+                    sum.fetch_add(*value, memory_order_seq_cst);
                 }
             }
         }));
@@ -228,7 +222,7 @@ int fc_stack_test_advanced(int num_threads, vector<int>& arr) {
     // Verification checks
     
     // 1. Check if final stack is empty
-    if (mystack.pop_stack() != -1) {
+    if (mystack.pop_stack()) {
         cout << "Stack should be empty at this point" << endl;
         return -1;
     }
@@ -279,7 +273,7 @@ int fc_queue_test_advanced(int num_threads, vector<int>& arr) {
     atomic<int> sum(0);
     int sum_actual = 0;
     
-    FC myqueue;
+    FC<int> myqueue;
     vector<thread> local_threads;
 
     // enqueue threads
@@ -303,20 +297,20 @@ int fc_queue_test_advanced(int num_threads, vector<int>& arr) {
     for (int i = 0; i < num_thread_for_each_ops; i++) {
         local_threads.push_back(thread([&, i]() {
             for (int j = 0; j < arr.size(); j++) {
-                int value = myqueue.dequeue_queue();
+                optional<int> value = myqueue.dequeue_queue();
                 
                 // Only process valid dequeue values
-                if (value != -1) {
+                if (value) {
                     // Track dequeue operation
                     int dequeue_index = dequeue_counter.fetch_add(1, memory_order_seq_cst);
                     assert(dequeue_index < test_dequeue_arr.size());
                     
                     // Store dequeueped value
                     int index = i * arr.size() + j;
-                    test_dequeue_arr[index].store(value, memory_order_seq_cst);
+                    test_dequeue_arr[index].store(*value, memory_order_seq_cst);
                     
                     // Update sum
-                    sum.fetch_add(value, memory_order_seq_cst);
+                    sum.fetch_add(*value, memory_order_seq_cst);
                 }
             }
         }));
@@ -335,7 +329,7 @@ int fc_queue_test_advanced(int num_threads, vector<int>& arr) {
     // Verification checks
     
     // 1. Check if final Queue is empty
-    if (myqueue.dequeue_queue() != -1) {
+    if (myqueue.dequeue_queue()) {
         cout << "Queue should be empty at this point" << endl;
         return -1;
     }
@@ -0,0 +1,366 @@
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include "common_header_file.h"
+#include "reclamation.h"
+#include "backoff.h"
+#include "bench.h"
+
+using namespace std;
+
+// Objects that are already allocated by the user are linked directly: the object derives
+// from intrusive_hook and push/pop allocate nothing.
+// A popped object is handed to a callback while the pop still protects it and then retired
+// to the reclamation scheme. Disposer()(obj) runs once no other thread can read its hook any
+// more; only then may the object be pushed again or freed. With no_reclaim it never runs.
+
+// Hook embedded in the objects of the intrusive containers. An object can be in one
+// intrusive container at a time.
+class intrusive_hook {
+public:
+    atomic<intrusive_hook*> next{nullptr};
+};
+
+template<class T, class Disposer, class Reclaim = hp_reclaim, class Backoff = no_backoff>
+class intrusive_tstack {
+private:
+    atomic<intrusive_hook*> top{nullptr};
+
+    static void dispose(void* p) {
+        Disposer()(static_cast<T*>(static_cast<intrusive_hook*>(p)));
+    }
+
+public:
+    typedef Reclaim reclaim;
+
+    // Disposes the objects still on the stack
+    ~intrusive_tstack();
+    void push(T& obj);
+    // Calls f(obj) on the top object and retires it, false when the stack is empty
+    template<class F>
+    bool pop(F&& f);
+};
+
+template<class T, class Disposer, class Reclaim, class Backoff>
+intrusive_tstack<T, Disposer, Reclaim, Backoff>::~intrusive_tstack() {
+    intrusive_hook* t = top.load(memory_order_acquire);
+    while (t != nullptr) {
+        intrusive_hook* n = t->next.load(memory_order_relaxed);
+        dispose(t);
+        t = n;
+    }
+}
+
+template<class T, class Disposer, class Reclaim, class Backoff>
+void intrusive_tstack<T, Disposer, Reclaim, Backoff>::push(T& obj) {
+    intrusive_hook* n = &obj;
+    Backoff backoff;
+    intrusive_hook* t = top.load(memory_order_acquire);
+    while (true) {
+        n->next.store(t, memory_order_release);
+        if (top.compare_exchange_strong(t, n, memory_order_acq_rel)) // linearization point
+            break;
+        backoff.fail();
+    }
+}
+
+template<class T, class Disposer, class Reclaim, class Backoff>
+template<class F>
+bool intrusive_tstack<T, Disposer, Reclaim, Backoff>::pop(F&& f) {
+    typename Reclaim::guard g;
+    Backoff backoff;
+    intrusive_hook* t;
+    intrusive_hook* n;
+    while (true) {
+        t = g.protect(0, top); // t cannot be disposed while it is protected
+        if (t == nullptr)
+            return false; // Stack is empty
+        n = t->next.load(memory_order_acquire);
+        if (top.compare_exchange_strong(t, n, memory_order_acq_rel)) // linearization point
+            break;
+        backoff.fail();
+    }
+
+    f(*static_cast<T*>(t));
+    g.clear(0);
+    Reclaim::retire(t, dispose); // Disposed once no other popper can still be reading t->next
+    return true;
+}
+
+// The first dummy is the stub inside the queue. After that the last dequeued object stays
+// in the queue as the dummy and is only retired when the next dequeue moves past it.
+template<class T, class Disposer, class Reclaim = hp_reclaim, class Backoff = no_backoff>
+class intrusive_msqueue {
+private:
+    intrusive_hook stub;
+    atomic<intrusive_hook*> head, tail;
+
+    static void dispose(void* p) {
+        Disposer()(static_cast<T*>(static_cast<intrusive_hook*>(p)));
+    }
+
+public:
+    typedef Reclaim reclaim;
+
+    intrusive_msqueue() : head(&stub), tail(&stub) {}
+    // Disposes the current dummy and the objects still in the queue
+    ~intrusive_msqueue();
+    void enqueue(T& obj);
+    // Calls f(obj) on the front object, false when the queue is empty
+    template<class F>
+    bool dequeue(F&& f);
+};
+
+template<class T, class Disposer, class Reclaim, class Backoff>
+intrusive_msqueue<T, Disposer, Reclaim, Backoff>::~intrusive_msqueue() {
+    intrusive_hook* n = head.load(memory_order_acquire);
+    while (n != nullptr) {
+        intrusive_hook* next = n->next.load(memory_order_relaxed);
+        if (n != &stub)
+            dispose(n);
+        n = next;
+    }
+}
+
+template<class T, class Disposer, class Reclaim, class Backoff>
+void intrusive_msqueue<T, Disposer, Reclaim, Backoff>::enqueue(T& obj) {
+    typename Reclaim::guard g;
+    Backoff backoff;
+    intrusive_hook* new_node = &obj;
+    intrusive_hook *tail_node, *end;
+    new_node->next.store(nullptr, memory_order_relaxed);
+    while (true) {
+        intrusive_hook* expected = nullptr;
+        tail_node = g.protect(0, tail);
+        end = tail_node->next.load(memory_order_acquire);
+        if (tail_node == tail.load(memory_order_acquire)) {
+            if (end == nullptr) {
+                if (tail_node->next.compare_exchange_strong(expected, new_node, memory_order_acq_rel))
+                    break; // linearization point
+                backoff.fail(); // Another enqueue linked its object first
+            }
+            else
+                tail.compare_exchange_strong(tail_node, end, memory_order_acq_rel);
+        }
+    }
+    tail.compare_exchange_strong(tail_node, new_node, memory_order_acq_rel);
+}
+
+template<class T, class Disposer, class Reclaim, class Backoff>
+template<class F>
+bool intrusive_msqueue<T, Disposer, Reclaim, Backoff>::dequeue(F&& f) {
+    typename Reclaim::guard g;
+    Backoff backoff;
+    intrusive_hook *tail_node, *dummy_node, *new_node;
+    while (true) {
+        dummy_node = g.protect(0, head);
+        tail_node = tail.load(memory_order_acquire);
+        new_node = g.protect(1, dummy_node->next);
+        if (dummy_node != head.load(memory_order_acquire))
+            continue;
+        if (dummy_node == tail_node) {
+            if (new_node == nullptr)
+                return false; // Queue is empty
+            tail.compare_exchange_strong(tail_node, new_node, memory_order_acq_rel);
+        }
+        else if (head.compare_exchange_strong(dummy_node, new_node, memory_order_acq_rel)) { // linearization point
+            // new_node is the dummy now and stays protected by slot 1 until we return
+            f(*static_cast<T*>(new_node));
+            g.clear(0);
+            if (dummy_node != &stub)
+                Reclaim::retire(dummy_node, dispose);
+            return true;
+        }
+        else
+            backoff.fail();
+    }
+}
+
+// Payload object of the tests and benchmarks. in_use is set by the producer and cleared by
+// the disposer, so an object is only reused once the container is done with it.
+class message : public intrusive_hook {
+public:
+    int value = 0;
+    atomic<bool> in_use{false};
+};
+
+class release_message {
+public:
+    void operator()(message* m) const { m->in_use.store(false, memory_order_release); }
+};
+
+// Half the threads push their own objects holding the values of arr, the other half pop
+// until they got arr.size() values each. push(c, obj) and pop(c, f) adapt the container.
+template<class Container, class Push, class Pop>
+static int intrusive_test_run(const char* name, int num_threads, vector<int>& arr, Push push, Pop pop) {
+    int num_thread_for_each_ops = (num_threads / 2);
+    vector<message> objects(num_thread_for_each_ops * arr.size());
+
+    atomic<int> push_counter(0);
+    atomic<int> pop_counter(0);
+    atomic<long> sum(0);
+    long sum_actual = 0;
+    bool empty;
+
+    {
+        Container c;
+        vector<thread> local_threads;
+
+        for (int i = 0; i < num_thread_for_each_ops; i++) {
+            local_threads.push_back(thread([&, i]() {
+                for (size_t j = 0; j < arr.size(); j++) {
+                    message& m = objects[i * arr.size() + j];
+                    m.value = arr[j];
+                    m.in_use.store(true, memory_order_relaxed);
+                    push(c, m);
+                    push_counter.fetch_add(1, memory_order_seq_cst);
+                }
+            }));
+        }
+
+        for (int i = 0; i < num_thread_for_each_ops; i++) {
+            local_threads.push_back(thread([&]() {
+                for (size_t j = 0; j < arr.size(); j++) {
+                    while (!pop(c, [&](message& m) { sum.fetch_add(m.value, memory_order_seq_cst); }))
+                        this_thread::yield();
+                    pop_counter.fetch_add(1, memory_order_seq_cst);
+                }
+            }));
+        }
+
+        for (auto& t : local_threads)
+            t.join();
+
+        empty = !pop(c, [](message&) {});
+    }
+    // The workers are joined, every retired object can be disposed now
+    Container::reclaim::drain();
+
+    for (size_t j = 0; j < arr.size(); j++)
+        sum_actual += arr[j] * num_thread_for_each_ops;
+
+    // 1. Check if final container is empty
+    if (!empty) {
+        cout << name << " should be empty at this point" << endl;
+        return -1;
+    }
+
+    // 2. Verify push and pop counts
+    int expected_total_ops = num_thread_for_each_ops * arr.size();
+    cout << "Expected total operations: " << expected_total_ops << endl;
+    cout << "Actual push count: " << push_counter.load() << endl;
+    cout << "Actual pop count: " << pop_counter.load() << endl;
+    if (push_counter.load() != expected_total_ops || pop_counter.load() != expected_total_ops) {
+        cout << "Push/pop count mismatch" << endl;
+        return -1;
+    }
+
+    // 3. Verify sum
+    if (sum_actual != sum.load()) {
+        cout << "Sum mismatch" << endl;
+        return -1;
+    }
+
+    // 4. Every object has been handed back through the disposer
+    if (!is_same_v<typename Container::reclaim, no_reclaim>) {
+        for (auto& m : objects) {
+            if (m.in_use.load(memory_order_acquire)) {
+                cout << "An object was never disposed" << endl;
+                return -1;
+            }
+        }
+    }
+
+    cout << "Test passed successfully" << endl;
+    return 0;
+}
+
+int intrusive_tstack_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim) {
+    return with_reclaim(reclaim, [&]<class Reclaim>() {
+        return intrusive_test_run<intrusive_tstack<message, release_message, Reclaim>>("Stack", num_threads, arr,
+            [](auto& c, message& m) { c.push(m); },
+            [](auto& c, auto&& f) { return c.pop(f); });
+    });
+}
+
+int intrusive_msqueue_test_advanced(int num_threads, vector<int>& arr, reclaim_type reclaim) {
+    return with_reclaim(reclaim, [&]<class Reclaim>() {
+        return intrusive_test_run<intrusive_msqueue<message, release_message, Reclaim>>("Queue", num_threads, arr,
+            [](auto& c, message& m) { c.enqueue(m); },
+            [](auto& c, auto&& f) { return c.dequeue(f); });
+    });
+}
+
+// Objects every producer of the benchmark recycles, well above the number of objects that
+// can wait in retire lists.
+#define INTRUSIVE_RING_SIZE 16384
+
+// Same split as run_throughput, every producer cycles through its own ring of objects and
+// only pushes an object again once it has been disposed.
+template<class Container, class Push, class Pop>
+static double intrusive_throughput(int num_threads, vector<int>& arr, int iters, Push push, Pop pop) {
+    int num_thread_for_each_ops = max(num_threads / 2, 1);
+    long ops_per_thread = (long)arr.size() * iters;
+    vector<message> objects(num_thread_for_each_ops * INTRUSIVE_RING_SIZE);
+    double secs;
+
+    {
+        Container c;
+        secs = run_split(num_threads,
+            [&](int i) {
+                message* ring = &objects[i * INTRUSIVE_RING_SIZE];
+                long n = 0;
+                for (int k = 0; k < iters; k++) {
+                    for (size_t j = 0; j < arr.size(); j++) {
+                        // Objects still waiting in a retire list are skipped, the retire list
+                        // of a consumer that waits on an empty container does not shrink
+                        while (ring[n % INTRUSIVE_RING_SIZE].in_use.load(memory_order_acquire)) {
+                            if (++n % INTRUSIVE_RING_SIZE == 0)
+                                this_thread::yield();
+                        }
+                        message& m = ring[n++ % INTRUSIVE_RING_SIZE];
+                        m.in_use.store(true, memory_order_relaxed);
+                        m.value = arr[j];
+                        push(c, m);
+                    }
+                }
+            },
+            [&](int) {
+                long sum = 0;
+                for (long j = 0; j < ops_per_thread; j++) {
+                    while (!pop(c, [&](message& m) { sum += m.value; }))
+                        this_thread::yield();
+                }
+            });
+    }
+    Container::reclaim::drain();
+
+    return (2.0 * num_thread_for_each_ops * ops_per_thread) / secs;
+}
+
+// Rows of the intrusive benchmark, same columns as the reclamation benchmark so the
+// allocating containers can be printed in the same table
+int intrusive_reclaim_bench(int num_threads, vector<int>& arr, int iters, reclaim_type reclaim) {
+    if (reclaim == RECLAIM_NONE) {
+        cout << "| INTRUSIVE | none | " << num_threads << " | objects are never disposed, not run | - |" << endl;
+        return 0;
+    }
+
+    double stack_ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        return intrusive_throughput<intrusive_tstack<message, release_message, Reclaim>>(num_threads, arr, iters,
+            [](auto& c, message& m) { c.push(m); },
+            [](auto& c, auto&& f) { return c.pop(f); });
+    });
+    cout << "| INTRUSIVE_TREIBER_STACK | " << reclaim_name(reclaim) << " | " << num_threads << " | "
+         << (long)stack_ops << " | " << peak_rss_kb() << " |" << endl;
+
+    double queue_ops = with_reclaim(reclaim, [&]<class Reclaim>() {
+        return intrusive_throughput<intrusive_msqueue<message, release_message, Reclaim>>(num_threads, arr, iters,
+            [](auto& c, message& m) { c.enqueue(m); },
+            [](auto& c, auto&& f) { return c.dequeue(f); });
+    });
+    cout << "| INTRUSIVE_M_and_S_QUEUE | " << reclaim_name(reclaim) << " | " << num_threads << " | "
+         << (long)queue_ops << " | " << peak_rss_kb() << " |" << endl;
+    return 0;
+}
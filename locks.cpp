@@ -1,4 +1,70 @@
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+#include <sched.h>
+#include <unistd.h>
 #include "locks.h"
+#include "bench.h"
+
+barrier::barrier(barrier_type bar, int num_threads) : cnt(0), sense(false), N(num_threads), is_pthread_barrier(false), rounds(0) {
+    switch(bar) {
+        case PTHREAD_BAR:
+            pthread_barrier_init(&br, NULL, num_threads);
+            is_pthread_barrier = true;
+            break;
+        case SENSE_SEQ:
+        case SENSE_REL:
+            break;
+        case TREE_BAR:{
+            threads.reset(new thread_state[num_threads]);
+            // Leaves take the threads, every level above the nodes of the one below it
+            vector<int> level_nodes;
+            int total = 0;
+            for (int below = num_threads; level_nodes.empty() || below > 1; ) {
+                below = (below + BARRIER_TREE_RADIX - 1) / BARRIER_TREE_RADIX;
+                level_nodes.push_back(below);
+                total += below;
+            }
+            tree.reset(new tree_node[total]);
+            int below = num_threads; // Threads or nodes of the level below
+            int begin = 0;           // First node of the level
+            for (size_t l = 0; l < level_nodes.size(); l++) {
+                for (int i = 0; i < level_nodes[l]; i++) {
+                    tree[begin + i].arrivals = min(BARRIER_TREE_RADIX, below - i * BARRIER_TREE_RADIX);
+                    if (l + 1 < level_nodes.size())
+                        tree[begin + i].parent = begin + level_nodes[l] + i / BARRIER_TREE_RADIX;
+                }
+                begin += level_nodes[l];
+                below = level_nodes[l];
+            }
+            break;
+        }
+        case DISSEMINATION_BAR:
+            // Each thread has flags for BARRIER_MAX_ROUNDS rounds only
+            if (num_threads > (1 << BARRIER_MAX_ROUNDS))
+                throw invalid_argument("dissemination barrier takes at most " + to_string(1 << BARRIER_MAX_ROUNDS) + " threads");
+            threads.reset(new thread_state[num_threads]);
+            while ((1 << rounds) < num_threads)
+                rounds++;
+            break;
+        default:
+            break;
+    }
+}
+
+const char* barrier_name(barrier_type type) {
+    switch (type) {
+        case PTHREAD_BAR: return "pthread";
+        case SENSE_SEQ: return "sense";
+        case SENSE_REL: return "sense_rel";
+        case TREE_BAR: return "tree";
+        case DISSEMINATION_BAR: return "dissemination";
+        default: return "none";
+    }
+}
 
 void barrier::sense_wait(void) {
         thread_local int my_sense = false;
@@ -13,7 +79,9 @@ void barrier::sense_wait(void) {
             cnt.store(0, memory_order_release);
             sense.store(my_sense, memory_order_seq_cst);
         } else {
+            pause_yield_spin spin;
             while (sense.load(memory_order_seq_cst) != my_sense) {
+                spin.wait();
             }
         }
 }
@@ -31,12 +99,53 @@ void barrier::sense_wait_rel(void) {
             cnt.store(0, memory_order_release);
             sense.store(my_sense, memory_order_release);
         } else {
+            pause_yield_spin spin;
             while (sense.load(memory_order_acquire) != my_sense) {
+                spin.wait();
             }
         }
 }
 
-void barrier::apply_barrier(barrier_type bar_type){
+void barrier::tree_arrive(int node, int my_sense) {
+    tree_node& n = tree[node];
+    int position = n.count.fetch_add(1, memory_order_acq_rel);
+    if (position == n.arrivals - 1) {
+        // Last one here: wait for the rest of the tree, then release this node
+        if (n.parent >= 0)
+            tree_arrive(n.parent, my_sense);
+        n.count.store(0, memory_order_relaxed);
+        n.sense.store(my_sense, memory_order_release);
+    } else {
+        pause_yield_spin spin;
+        while (n.sense.load(memory_order_acquire) != my_sense) {
+            spin.wait();
+        }
+    }
+}
+
+void barrier::tree_wait(int tid) {
+    thread_state& me = threads[tid];
+    tree_arrive(tid / BARRIER_TREE_RADIX, me.sense);
+    me.sense = !me.sense;
+}
+
+void barrier::dissemination_wait(int tid) {
+    thread_state& me = threads[tid];
+    for (int r = 0; r < rounds; r++) {
+        int partner = (tid + (1 << r)) % N;
+        threads[partner].flags[me.parity][r].store(me.sense, memory_order_release);
+        pause_yield_spin spin;
+        while (me.flags[me.parity][r].load(memory_order_acquire) != me.sense) {
+            spin.wait();
+        }
+    }
+    // The flags of a parity are used every other phase, the sense flips after both
+    if (me.parity == 1)
+        me.sense = !me.sense;
+    me.parity = 1 - me.parity;
+}
+
+void barrier::apply_barrier(barrier_type bar_type, int tid){
     switch(bar_type){
         case PTHREAD_BAR:
             pthread_barrier_wait(&br);
@@ -49,6 +158,14 @@ void barrier::apply_barrier(barrier_type bar_type){
         case SENSE_REL:
             sense_wait_rel();
             break;
+
+        case TREE_BAR:
+            tree_wait(tid);
+            break;
+
+        case DISSEMINATION_BAR:
+            dissemination_wait(tid);
+            break;
         
         default:
             break;
@@ -57,7 +174,7 @@ void barrier::apply_barrier(barrier_type bar_type){
 }
 
 
-locks::locks(locks_type type) : flag(0), next_num(0), now_serving(0), tail(nullptr), is_mcs_lock(false), is_pthread_lock(false) {
+locks::locks(locks_type type) : flag(0), next_num(0), now_serving(0), tail(nullptr), is_pthread_lock(false), mcs_holder_node(nullptr) {
     switch (type) {
         case PTHREAD_LOCK:
             pthread_mutex_init(&pthread_lk, NULL);
@@ -77,13 +194,13 @@ locks::locks(locks_type type) : flag(0), next_num(0), now_serving(0), tail(nullp
             now_serving.store(0, memory_order_relaxed);
             break;
         case PETERSON_LOCK:
+        case PETERSONREL_LOCK:
             desires[0].store(false, memory_order_relaxed);
             desires[1].store(false, memory_order_relaxed);
             turn.store(0, memory_order_relaxed);
             break;
         case MCS_LOCK:
         case MCSREL_LOCK:
-            is_mcs_lock = true;
             tail.store(nullptr, memory_order_release);
             break;
         default:
@@ -92,7 +209,82 @@ locks::locks(locks_type type) : flag(0), next_num(0), now_serving(0), tail(nullp
     }
 }
 
-thread_local Node* locks::thread_node = nullptr;
+
+const char* lock_name(locks_type type) {
+    switch (type) {
+        case PTHREAD_LOCK: return "pthread";
+        case TAS_LOCK: return "tas";
+        case TTAS_LOCK: return "ttas";
+        case TICKET_LOCK: return "ticket";
+        case MCS_LOCK: return "mcs";
+        case PETERSON_LOCK: return "peterson";
+        case TASREL_LOCK: return "tas_rel";
+        case TTASREL_LOCK: return "ttas_rel";
+        case TICKETREL_LOCK: return "ticket_rel";
+        case MCSREL_LOCK: return "mcs_rel";
+        case PETERSONREL_LOCK: return "peterson_rel";
+        case CLH_LOCK: return "clh";
+        case CLHREL_LOCK: return "clh_rel";
+        case COHORT_TTAS_LOCK: return "cohort_ttas";
+        case COHORT_MCS_LOCK: return "cohort_mcs";
+        case ADAPTIVE_LOCK: return "adaptive";
+        default: return "none";
+    }
+}
+
+// Socket of every cpu from sysfs. With a single socket the threads are dealt round robin to
+// simulated_sockets sockets, so the cohort locks still have cohorts to keep apart.
+static const int simulated_sockets = 2;
+
+class cpu_topology {
+public:
+    vector<int> socket_of_cpu;
+    int sockets = 1;
+    bool simulated = false;
+
+    cpu_topology() {
+        map<int, int> socket_index; // physical_package_id -> socket number
+        long cpus = sysconf(_SC_NPROCESSORS_CONF);
+        for (long cpu = 0; cpu < cpus; cpu++) {
+            ifstream f("/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/physical_package_id");
+            int id = 0;
+            f >> id;
+            auto it = socket_index.emplace(id, (int)socket_index.size()).first;
+            socket_of_cpu.push_back(it->second);
+        }
+        sockets = (int)socket_index.size();
+        if (sockets <= 1) {
+            sockets = simulated_sockets;
+            simulated = true;
+        }
+    }
+};
+
+static const cpu_topology& topology() {
+    static cpu_topology t;
+    return t;
+}
+
+int lock_sockets() {
+    return topology().sockets;
+}
+
+bool lock_sockets_simulated() {
+    return topology().simulated;
+}
+
+int this_thread_socket() {
+    const cpu_topology& t = topology();
+    if (t.simulated) {
+        static atomic<int> next_thread(0);
+        thread_local int socket = next_thread.fetch_add(1, memory_order_relaxed) % t.sockets;
+        return socket;
+    }
+    int cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= (int)t.socket_of_cpu.size())
+        return 0;
+    return t.socket_of_cpu[cpu];
+}
 
 bool locks::test_and_set(memory_order MEM) {
     int expected = 0;
@@ -100,7 +292,9 @@ bool locks::test_and_set(memory_order MEM) {
 }
 
 void locks::tas_lock(memory_order MEM) {
-    while (test_and_set(MEM) == false);
+    pause_yield_spin spin;
+    while (test_and_set(MEM) == false)
+        spin.wait();
 }
 
 void locks::tas_unlock(memory_order MEM) {
@@ -108,7 +302,9 @@ void locks::tas_unlock(memory_order MEM) {
 }
 
 void locks::ttas_lock(memory_order MEM1, memory_order MEM2) {
-    while (flag.load(MEM1) == true || test_and_set(MEM2) == false);
+    pause_yield_spin spin;
+    while (flag.load(MEM1) == true || test_and_set(MEM2) == false)
+        spin.wait();
 }
 
 void locks::ttas_unlock(memory_order MEM) {
@@ -117,7 +313,9 @@ void locks::ttas_unlock(memory_order MEM) {
 
 void locks::ticket_lock(memory_order MEM1, memory_order MEM2) {
     int my_num = next_num.fetch_add(1, MEM1);
-    while (now_serving.load(MEM2) != my_num);
+    pause_yield_spin spin;
+    while (now_serving.load(MEM2) != my_num)
+        spin.wait();
 }
 
 void locks::ticket_unlock(memory_order MEM) {
@@ -133,7 +331,9 @@ void locks::MCS_lock(Node* myNode) {
     if (oldTail != nullptr) {
         myNode->wait.store(true, memory_order_relaxed);
         oldTail->next.store(myNode, memory_order_seq_cst);
-        while (myNode->wait.load(memory_order_seq_cst));
+        pause_yield_spin spin;
+        while (myNode->wait.load(memory_order_seq_cst))
+            spin.wait();
     }
 }
 
@@ -142,7 +342,9 @@ void locks::MCS_unlock(Node* myNode) {
     if (tail.compare_exchange_strong(m, nullptr, memory_order_seq_cst)) {
     } 
     else {
-        while (myNode->next.load(memory_order_seq_cst) == nullptr);
+        pause_yield_spin spin;
+        while (myNode->next.load(memory_order_seq_cst) == nullptr)
+            spin.wait();
         Node* nextNode = myNode->next.load(memory_order_seq_cst);
         nextNode->wait.store(false, memory_order_seq_cst);
     }
@@ -151,14 +353,17 @@ void locks::MCS_unlock(Node* myNode) {
 void locks::MCSREL_lock(Node *myNode){
     Node* oldTail = tail.load(memory_order_acquire);
     myNode->next.store(nullptr, memory_order_relaxed);
-    while (!tail.compare_exchange_strong(oldTail, myNode, memory_order_release)) {
+    // acq_rel: taking a free lock must see the writes of the previous holder
+    while (!tail.compare_exchange_strong(oldTail, myNode, memory_order_acq_rel)) {
         oldTail = tail.load(memory_order_acquire);
     }
       
     if (oldTail != nullptr) {
         myNode->wait.store(true, memory_order_relaxed);      
         oldTail->next.store(myNode, memory_order_release); 
-        while (myNode->wait.load(memory_order_acquire));
+        pause_yield_spin spin;
+        while (myNode->wait.load(memory_order_acquire))
+            spin.wait();
     }
 }
 
@@ -167,7 +372,9 @@ void locks::MCSREL_unlock(Node *myNode){
         if (tail.compare_exchange_strong(m, nullptr, memory_order_release)){
         }
         else{
-        while (myNode->next.load(memory_order_acquire) == nullptr);        
+        pause_yield_spin spin;
+        while (myNode->next.load(memory_order_acquire) == nullptr)
+            spin.wait();
         Node* nextNode = myNode->next.load(memory_order_relaxed);
         nextNode->wait.store(false, memory_order_release);
         }
@@ -175,9 +382,21 @@ void locks::MCSREL_unlock(Node *myNode){
 
 
 void locks::Peterson_lock(memory_order MEM1, int tid) {
-    desires[tid].store(true, MEM1);
-    turn.store(!tid, MEM1);
-    while (desires[!tid].load(MEM1) && turn.load(MEM1) == !tid);
+    if (MEM1 == memory_order_seq_cst) {
+        desires[tid].store(true, MEM1);
+        turn.store(!tid, MEM1);
+        pause_yield_spin spin;
+        while (desires[!tid].load(MEM1) && turn.load(MEM1) == !tid)
+            spin.wait();
+        return;
+    }
+    // Acquire is no valid order for a store, and the stores must not pass the loads below
+    desires[tid].store(true, memory_order_relaxed);
+    turn.store(!tid, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    pause_yield_spin spin;
+    while (desires[!tid].load(MEM1) && turn.load(MEM1) == !tid)
+        spin.wait();
 }
 
 void locks::Peterson_unlock(memory_order MEM1, int tid) {
@@ -195,9 +414,13 @@ void locks::apply_lock(locks_type type, long tid) {
         case TICKET_LOCK:
             ticket_lock(memory_order_seq_cst, memory_order_seq_cst);
             break;
-        case MCS_LOCK:
-            MCS_lock(get_thread_node());
+        case MCS_LOCK:{
+            // Published only once held, a waiter must not overwrite the holder's node
+            Node* n = queue_node_cache<Node>::local().get();
+            MCS_lock(n);
+            mcs_holder_node = n;
             break;
+        }
         case PTHREAD_LOCK:
             pthread_mutex_lock(&pthread_lk);
             break;
@@ -213,9 +436,13 @@ void locks::apply_lock(locks_type type, long tid) {
         case TICKETREL_LOCK:
             ticket_lock(memory_order_acquire, memory_order_acquire);
             break;
-        case MCSREL_LOCK:
-            MCSREL_lock(get_thread_node());
+        case MCSREL_LOCK:{
+            // Published only once held, a waiter must not overwrite the holder's node
+            Node* n = queue_node_cache<Node>::local().get();
+            MCSREL_lock(n);
+            mcs_holder_node = n;
             break;
+        }
         case PETERSONREL_LOCK:
             Peterson_lock(memory_order_acquire, tid);
             break;
@@ -235,9 +462,12 @@ void locks::lock_unlock(locks_type type, long tid) {
         case TICKET_LOCK:
             ticket_unlock(memory_order_seq_cst);
             break;
-        case MCS_LOCK:
-            MCS_unlock(get_thread_node());
+        case MCS_LOCK:{
+            Node* n = mcs_holder_node;
+            MCS_unlock(n);
+            queue_node_cache<Node>::local().put(n);
             break;
+        }
         case PTHREAD_LOCK:
             pthread_mutex_unlock(&pthread_lk);
             break;
@@ -253,9 +483,12 @@ void locks::lock_unlock(locks_type type, long tid) {
         case TICKETREL_LOCK:
             ticket_unlock(memory_order_release);
             break;
-        case MCSREL_LOCK:
-            MCSREL_unlock(get_thread_node());
+        case MCSREL_LOCK:{
+            Node* n = mcs_holder_node;
+            MCSREL_unlock(n);
+            queue_node_cache<Node>::local().put(n);
             break;
+        }
         case PETERSONREL_LOCK:
             Peterson_unlock(memory_order_release, tid);
             break;
@@ -263,3 +496,170 @@ void locks::lock_unlock(locks_type type, long tid) {
             break;
     }
 }
+
+// Starts num_threads threads together on thread_body() and returns the seconds until all of
+// them finished
+template<class Body>
+static double run_lock_threads(int num_threads, Body thread_body) {
+    atomic<bool> go(false);
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.push_back(thread([&]() {
+            while (!go.load(memory_order_acquire))
+                this_thread::yield();
+            thread_body();
+        }));
+    }
+    auto begin = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    for (auto& t : threads)
+        t.join();
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+// Runs num_threads threads that each go through critical(body) rounds times and prints one
+// row: throughput and the share of acquisitions that took the lock over from a holder on
+// another socket. critical runs body with the lock (or locks) held.
+template<class Critical>
+static void handoff_row(const char* name, int num_threads, long rounds, Critical critical) {
+    long count = 0;
+    long handoffs = 0;
+    int last_socket = -1;
+    double secs = run_lock_threads(num_threads, [&]() {
+        int socket = this_thread_socket();
+        for (long r = 0; r < rounds; r++) {
+            critical([&]() {
+                count++;
+                if (last_socket != socket)
+                    handoffs++;
+                last_socket = socket;
+            });
+        }
+    });
+    cout << "| " << name << " | " << num_threads << " | " << lock_sockets()
+         << (lock_sockets_simulated() ? " (simulated)" : "") << " | " << (long)(count / secs) << " | "
+         << 100.0 * handoffs / count << " |";
+    if (count != rounds * num_threads)
+        cout << " count mismatch";
+    cout << endl;
+}
+
+// The queue and cohort locks with iters * 100 acquisitions per thread (or only the given
+// kind), then the MCS lock held twice at once through its node cache and through guards
+int queue_lock_bench(int num_threads, int iters, locks_type only, bool only_given) {
+    long rounds = (long)iters * 100;
+    const locks_type kinds[] = {PTHREAD_LOCK, TTASREL_LOCK, TICKETREL_LOCK, MCSREL_LOCK, CLHREL_LOCK,
+                                COHORT_TTAS_LOCK, COHORT_MCS_LOCK};
+    cout << "| Lock | Threads | Sockets | Acquisitions/sec | Socket handoffs (%) |" << endl;
+    cout << "|------|---------|---------|------------------|---------------------|" << endl;
+    for (locks_type kind : kinds) {
+        if (only_given && kind != only)
+            continue;
+        with_lock(kind, [&]<class Lock>() {
+            Lock l;
+            handoff_row(lock_name(kind), num_threads, rounds, [&](auto body) {
+                lock_guard<Lock> g(l);
+                body();
+            });
+            return 0;
+        });
+    }
+    if (only_given && only != MCSREL_LOCK)
+        return 0;
+    mcs_mutex<true> outer, inner;
+    handoff_row("mcs_rel nested", num_threads, rounds, [&](auto body) {
+        lock_guard<mcs_mutex<true>> g1(outer);
+        lock_guard<mcs_mutex<true>> g2(inner);
+        body();
+    });
+    handoff_row("mcs_rel nested guard", num_threads, rounds, [&](auto body) {
+        mcs_mutex<true>::guard g1(outer);
+        mcs_mutex<true>::guard g2(inner);
+        body();
+    });
+    return 0;
+}
+
+// One row of the oversubscription benchmark: num_threads threads take Lock rounds times each,
+// with a short critical section and a little work outside of it
+template<class Lock>
+static void oversubscription_row(const char* name, const char* policy, int num_threads, int cores, long rounds) {
+    Lock l;
+    long count = 0;
+    long cpu_begin = cpu_time_us();
+    double secs = run_lock_threads(num_threads, [&]() {
+        for (long r = 0; r < rounds; r++) {
+            {
+                lock_guard<Lock> g(l);
+                count++;
+            }
+            spin(16);
+        }
+    });
+    double cpu_secs = (cpu_time_us() - cpu_begin) / 1e6;
+    cout << "| " << name << " | " << policy << " | " << num_threads << " | " << num_threads / cores << "x | "
+         << (long)(count / secs) << " | " << 100.0 * cpu_secs / (secs * cores) << " |";
+    if (count != rounds * num_threads)
+        cout << " count mismatch";
+    cout << endl;
+}
+
+// Spin locks with and without the pause/yield spin policy, the adaptive lock and the pthread
+// mutex with 1, 2 and 4 threads per core, iters * 100 acquisitions per thread. Only ttas gets
+// a busy spin row: with more threads than cores the FIFO locks wait for a whole timeslice on
+// every handoff to a preempted thread and do not finish in useful time without yielding.
+int oversubscription_bench(int iters, locks_type only, bool only_given) {
+    int cores = max(1u, thread::hardware_concurrency());
+    long rounds = (long)iters * 100;
+    cout << "| Lock | Spin | Threads | Threads per core | Acquisitions/sec | CPU (%) |" << endl;
+    cout << "|------|------|---------|------------------|------------------|---------|" << endl;
+    for (int factor = 1; factor <= 4; factor *= 2) {
+        int t = cores * factor;
+        if (!only_given || only == TTASREL_LOCK)
+            oversubscription_row<ttas_mutex<true, busy_spin>>("ttas_rel", "busy", t, cores, rounds);
+        const locks_type kinds[] = {TTASREL_LOCK, TICKETREL_LOCK, MCSREL_LOCK, ADAPTIVE_LOCK, PTHREAD_LOCK};
+        for (locks_type kind : kinds) {
+            if (only_given && kind != only)
+                continue;
+            bool spins = kind != ADAPTIVE_LOCK && kind != PTHREAD_LOCK;
+            with_lock(kind, [&]<class Lock>() {
+                oversubscription_row<Lock>(lock_name(kind), spins ? "pause/yield" : "park", t, cores, rounds);
+                return 0;
+            });
+        }
+    }
+    return 0;
+}
+
+// Phase rate of every barrier kind at 2, 4, 8, ... up to num_threads threads, iters * 10
+// phases per row. Every thread counts its arrival before each phase and checks after it that
+// all threads arrived.
+int barrier_bench(int num_threads, int iters) {
+    long phases = (long)iters * 10;
+    const barrier_type kinds[] = {PTHREAD_BAR, SENSE_SEQ, SENSE_REL, TREE_BAR, DISSEMINATION_BAR};
+    cout << "| Barrier | Threads | Phases/sec | Phase (ns) |" << endl;
+    cout << "|---------|---------|------------|------------|" << endl;
+    for (int t = 2; t <= max(num_threads, 2); t *= 2) {
+        for (barrier_type kind : kinds) {
+            barrier bar(kind, t);
+            atomic<long> arrived(0);
+            atomic<int> next_tid(0);
+            atomic<bool> broken(false);
+            double secs = run_lock_threads(t, [&]() {
+                int tid = next_tid.fetch_add(1, memory_order_relaxed);
+                for (long p = 0; p < phases; p++) {
+                    arrived.fetch_add(1, memory_order_relaxed);
+                    bar.apply_barrier(kind, tid);
+                    if (arrived.load(memory_order_relaxed) < (p + 1) * t)
+                        broken.store(true, memory_order_relaxed);
+                }
+            });
+            cout << "| " << barrier_name(kind) << " | " << t << " | " << (long)(phases / secs) << " | "
+                 << secs * 1e9 / phases << " |";
+            if (broken.load())
+                cout << " a thread left a phase early";
+            cout << endl;
+        }
+    }
+    return 0;
+}
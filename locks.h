@@ -1,18 +1,43 @@
 #ifndef LOCKS_H
 #define LOCKS_H
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <climits>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "backoff.h"
 
 using namespace std;
 
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
 typedef enum {
     PTHREAD_BAR,
     SENSE_SEQ,
     SENSE_REL,
+    TREE_BAR,
+    DISSEMINATION_BAR,
     NO_BAR
 }barrier_type;
 
+// Arrivals per node of the combining tree barrier
+#define BARRIER_TREE_RADIX 4
+// Rounds of the dissemination barrier, its constructor rejects more than 2^16 threads
+#define BARRIER_MAX_ROUNDS 16
+
+// Name of the barrier as given to mysort
+const char* barrier_name(barrier_type type);
+
 class barrier{
 private:
     atomic<int> cnt;
@@ -21,25 +46,44 @@ private:
     pthread_barrier_t br;
     bool is_pthread_barrier;
 
+    // Combining tree: each node takes the arrivals of up to BARRIER_TREE_RADIX threads or
+    // child nodes, the last one to arrive goes on to the parent and on the way back releases
+    // the others by flipping the node's sense. Leaves come first, the root is the last node.
+    class alignas(CACHE_LINE_SIZE) tree_node {
+    public:
+        atomic<int> count{0};
+        atomic<int> sense{0};
+        int arrivals = 0;
+        int parent = -1;
+    };
+
+    // Per thread state of the tree and dissemination barriers, on its own lines. In round r of
+    // the dissemination barrier thread i signals thread i + 2^r (mod N) and waits for the signal
+    // of thread i - 2^r in flags[parity][r].
+    class alignas(CACHE_LINE_SIZE) thread_state {
+    public:
+        int sense = 1;
+        int parity = 0;
+        atomic<int> flags[2][BARRIER_MAX_ROUNDS] = {};
+    };
+
+    unique_ptr<tree_node[]> tree;
+    unique_ptr<thread_state[]> threads;
+    int rounds;
+
+    void tree_arrive(int node, int my_sense);
+
 public:    
     
-    barrier(barrier_type bar, int num_threads) : cnt(0), sense(false), N(num_threads), is_pthread_barrier(false){
-        switch(bar) {
-            case PTHREAD_BAR:
-                pthread_barrier_init(&br, NULL, num_threads);
-                is_pthread_barrier = true;
-                break;
-            case SENSE_SEQ:
-            case SENSE_REL:
-                break;
-            default:
-                break;
-        }
-    }
+    barrier(barrier_type bar, int num_threads);
 
     void sense_wait();
     void sense_wait_rel();
-    void apply_barrier(barrier_type bar);
+    void tree_wait(int tid);
+    void dissemination_wait(int tid);
+    // tid is the number of the calling thread from 0 to num_threads - 1, only the tree and
+    // dissemination barriers use it
+    void apply_barrier(barrier_type bar, int tid = 0);
 
     ~barrier() {
         if (is_pthread_barrier) {
@@ -61,9 +105,58 @@ enum locks_type {
     TICKETREL_LOCK,
     MCSREL_LOCK,
     PETERSONREL_LOCK,
+    CLH_LOCK,
+    CLHREL_LOCK,
+    COHORT_TTAS_LOCK,
+    COHORT_MCS_LOCK,
+    ADAPTIVE_LOCK,
     NO_LOCK
 };
 
+// Name of the lock as given to mysort with -l
+const char* lock_name(locks_type type);
+
+// Number of sockets the cohort locks keep apart, and the socket of the calling thread. On a
+// single socket machine the threads are dealt round robin to simulated sockets instead.
+int lock_sockets();
+bool lock_sockets_simulated();
+int this_thread_socket();
+
+// Number of the calling thread, threads are numbered in the order of their first call
+inline size_t thread_number() {
+    static atomic<size_t> next_number(0);
+    thread_local size_t number = next_number.fetch_add(1, memory_order_relaxed);
+    return number;
+}
+
+// Pause rounds of pause_yield_spin before it starts yielding the cpu
+#define LOCK_PAUSE_SPINS 128
+
+// Spin-wait policies of the spin locks, one object per waiting loop and wait() once per round.
+// pause_yield_spin pauses for the first rounds and then yields, so that with more threads than
+// cores a preempted holder or successor gets the cpu instead of waiting for a full timeslice.
+class pause_yield_spin {
+private:
+    uint32_t rounds = 0;
+
+public:
+    void wait() {
+        if (rounds < LOCK_PAUSE_SPINS) {
+            cpu_relax();
+            rounds++;
+        }
+        else {
+            this_thread::yield();
+        }
+    }
+};
+
+// Spins on the word with no pause or yield, for comparison
+class busy_spin {
+public:
+    void wait() {}
+};
+
 class Node {
 public:
     atomic<Node*> next;
@@ -72,6 +165,36 @@ public:
     Node() : next(nullptr), wait(false) {}
 };
 
+// Per thread list of free queue lock nodes. A queue lock takes one node for every acquisition
+// and gives it back to the list of the thread that is done with it, so a thread can hold any
+// number of queue locks at once. The nodes left in the list go away with the thread.
+template<class N>
+class queue_node_cache {
+private:
+    vector<N*> free_nodes;
+
+public:
+    static queue_node_cache& local() {
+        thread_local queue_node_cache cache;
+        return cache;
+    }
+
+    N* get() {
+        if (free_nodes.empty())
+            return new N();
+        N* n = free_nodes.back();
+        free_nodes.pop_back();
+        return n;
+    }
+
+    void put(N* n) { free_nodes.push_back(n); }
+
+    ~queue_node_cache() {
+        for (N* n : free_nodes)
+            delete n;
+    }
+};
+
 class locks {
 private:
     atomic<int> flag;
@@ -81,20 +204,12 @@ private:
     atomic<bool> desires[2];
     atomic<int> turn;
     pthread_mutex_t pthread_lk;
-    bool is_mcs_lock;
     bool is_pthread_lock;
-    static thread_local Node* thread_node;
+    Node* mcs_holder_node; // Queue node of the MCS holder, written and read by the holder only
 
 public:
     locks(locks_type type);
     
-    Node* get_thread_node() {
-        if (!thread_node) {
-            thread_node = new Node();
-        }
-        return thread_node;
-    }
-    
     bool test_and_set(memory_order MEM);
     void tas_lock(memory_order MEM);
     void tas_unlock(memory_order MEM);
@@ -114,9 +229,494 @@ public:
     ~locks(){
         if(is_pthread_lock)
             pthread_mutex_destroy(&pthread_lk);
-        else if(is_mcs_lock)
-            delete thread_node;
     }
 };
 
+// The locks class implements the kinds up to PETERSONREL_LOCK, the later ones only exist as
+// lock classes
+static inline bool has_switch_lock(locks_type type) {
+    return type <= PETERSONREL_LOCK;
+}
+
+// BasicLockable view of a locks object of one kind: every lock() and unlock() goes through
+// the switch in locks::apply_lock / locks::lock_unlock. Peterson locks need the id 0 or 1
+// of the caller: a thread claims a free id for the time it contends for and holds the lock,
+// so any two threads can use it one after the other, a third one waits for an id.
+template<locks_type Type>
+class locks_lock {
+private:
+    static constexpr bool is_peterson = Type == PETERSON_LOCK || Type == PETERSONREL_LOCK;
+    locks l{Type};
+    atomic<bool> peterson_id_used[2] = {false, false};
+    int holder_id = 0; // Written and read by the holder only
+
+    int claim_id() {
+        while (true) {
+            for (int i = 0; i < 2; i++) {
+                bool used = false;
+                if (peterson_id_used[i].compare_exchange_strong(used, true, memory_order_acquire))
+                    return i;
+            }
+            this_thread::yield();
+        }
+    }
+
+public:
+    void lock() {
+        int id = 0;
+        if constexpr (is_peterson)
+            id = claim_id();
+        l.apply_lock(Type, id);
+        holder_id = id;
+    }
+
+    void unlock() {
+        int id = holder_id;
+        l.lock_unlock(Type, id);
+        if constexpr (is_peterson)
+            peterson_id_used[id].store(false, memory_order_release);
+    }
+};
+
+// Lock kinds as separate BasicLockable classes, chosen at compile time. Each one holds only
+// its own state and fills exactly one cache line, and lock()/unlock() inline into the caller
+// with no switch. Rel selects the acquire/release flavour, the default is seq_cst like the
+// matching locks kind.
+template<bool Rel>
+class lock_orders {
+public:
+    static constexpr memory_order acquire = Rel ? memory_order_acquire : memory_order_seq_cst;
+    static constexpr memory_order release = Rel ? memory_order_release : memory_order_seq_cst;
+    static constexpr memory_order relaxed = Rel ? memory_order_relaxed : memory_order_seq_cst;
+};
+
+template<bool Rel = false, class Spin = pause_yield_spin>
+class alignas(CACHE_LINE_SIZE) tas_mutex {
+private:
+    using order = lock_orders<Rel>;
+    atomic<bool> flag{false};
+
+public:
+    void lock() {
+        Spin spin;
+        while (flag.exchange(true, order::acquire))
+            spin.wait();
+    }
+    void unlock() { flag.store(false, order::release); }
+};
+
+template<bool Rel = false, class Spin = pause_yield_spin>
+class alignas(CACHE_LINE_SIZE) ttas_mutex {
+private:
+    using order = lock_orders<Rel>;
+    atomic<bool> flag{false};
+
+public:
+    void lock() {
+        Spin spin;
+        while (flag.load(order::relaxed) || flag.exchange(true, order::acquire))
+            spin.wait();
+    }
+    void unlock() { flag.store(false, order::release); }
+};
+
+template<bool Rel = false, class Spin = pause_yield_spin>
+class alignas(CACHE_LINE_SIZE) ticket_mutex {
+private:
+    using order = lock_orders<Rel>;
+    atomic<int> next_num{0};
+    atomic<int> now_serving{0};
+
+public:
+    void lock() {
+        int my_num = next_num.fetch_add(1, order::relaxed);
+        Spin spin;
+        while (now_serving.load(order::acquire) != my_num)
+            spin.wait();
+    }
+    // Only the holder writes now_serving
+    void unlock() { now_serving.store(now_serving.load(memory_order_relaxed) + 1, order::release); }
+};
+
+class alignas(CACHE_LINE_SIZE) mcs_node {
+public:
+    atomic<mcs_node*> next{nullptr};
+    atomic<bool> wait{false};
+};
+
+// MCS queue lock. The queue node of an acquisition comes from the per thread node cache, or
+// from the caller through lock(mcs_node&) and guard, so a thread can hold several MCS locks
+// at once. Whoever releases the lock keeps the node, which lets another thread unlock it.
+template<bool Rel = false, class Spin = pause_yield_spin>
+class alignas(CACHE_LINE_SIZE) mcs_mutex {
+private:
+    using order = lock_orders<Rel>;
+    atomic<mcs_node*> tail{nullptr};
+    mcs_node* holder_node = nullptr; // Written and read by the holder only
+
+public:
+    void lock(mcs_node& n) {
+        n.next.store(nullptr, memory_order_relaxed);
+        n.wait.store(true, memory_order_relaxed);
+        mcs_node* prev = tail.exchange(&n, Rel ? memory_order_acq_rel : memory_order_seq_cst);
+        if (prev != nullptr) {
+            prev->next.store(&n, order::release);
+            Spin spin;
+            while (n.wait.load(order::acquire))
+                spin.wait();
+        }
+    }
+
+    void unlock(mcs_node& n) {
+        mcs_node* next = n.next.load(order::acquire);
+        if (next == nullptr) {
+            mcs_node* expected = &n;
+            if (tail.compare_exchange_strong(expected, nullptr, order::release))
+                return;
+            // A successor swapped the tail and is about to link itself
+            Spin spin;
+            while ((next = n.next.load(order::acquire)) == nullptr)
+                spin.wait();
+        }
+        next->wait.store(false, order::release);
+    }
+
+    void lock() {
+        mcs_node* n = queue_node_cache<mcs_node>::local().get();
+        lock(*n);
+        holder_node = n;
+    }
+
+    void unlock() {
+        mcs_node* n = holder_node;
+        unlock(*n);
+        queue_node_cache<mcs_node>::local().put(n);
+    }
+
+    // Holds the lock for its lifetime, queued with a node on the stack
+    class guard {
+    private:
+        mcs_mutex& m;
+        mcs_node n;
+
+    public:
+        explicit guard(mcs_mutex& m) : m(m) { m.lock(n); }
+        ~guard() { m.unlock(n); }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+    };
+};
+
+class alignas(CACHE_LINE_SIZE) clh_node {
+public:
+    atomic<bool> locked{false};
+};
+
+// CLH queue lock: a waiter spins on the node of its predecessor and takes that node over once
+// the lock is free, its own node stays in the queue for the successor. Nodes come from the
+// per thread node cache, the lock owns the one at the tail.
+template<bool Rel = false, class Spin = pause_yield_spin>
+class alignas(CACHE_LINE_SIZE) clh_mutex {
+private:
+    using order = lock_orders<Rel>;
+    atomic<clh_node*> tail;
+    clh_node* holder_node = nullptr; // Written and read by the holder only
+    clh_node* holder_pred = nullptr;
+
+public:
+    clh_mutex() : tail(new clh_node()) {}
+    ~clh_mutex() { delete tail.load(memory_order_relaxed); }
+    clh_mutex(const clh_mutex&) = delete;
+    clh_mutex& operator=(const clh_mutex&) = delete;
+
+    void lock() {
+        clh_node* n = queue_node_cache<clh_node>::local().get();
+        n->locked.store(true, memory_order_relaxed);
+        clh_node* pred = tail.exchange(n, Rel ? memory_order_acq_rel : memory_order_seq_cst);
+        Spin spin;
+        while (pred->locked.load(order::acquire))
+            spin.wait();
+        holder_node = n;
+        holder_pred = pred;
+    }
+
+    void unlock() {
+        clh_node* pred = holder_pred;
+        holder_node->locked.store(false, order::release);
+        // Nobody looks at the predecessor's node any more
+        queue_node_cache<clh_node>::local().put(pred);
+    }
+};
+
+// Peterson lock for two contenders. A thread claims a free id for the time it contends for
+// and holds the lock, so any two threads can use it one after the other and a third one
+// waits for an id.
+template<bool Rel = false, class Spin = pause_yield_spin>
+class alignas(CACHE_LINE_SIZE) peterson_mutex {
+private:
+    atomic<bool> desires[2] = {false, false};
+    atomic<int> turn{0};
+    atomic<bool> id_used[2] = {false, false};
+    int holder_id = 0; // Written and read by the holder only
+
+    int claim_id() {
+        while (true) {
+            for (int i = 0; i < 2; i++) {
+                bool used = false;
+                if (id_used[i].compare_exchange_strong(used, true, memory_order_acquire))
+                    return i;
+            }
+            this_thread::yield();
+        }
+    }
+
+public:
+    void lock() {
+        int id = claim_id();
+        if constexpr (Rel) {
+            desires[id].store(true, memory_order_relaxed);
+            turn.store(!id, memory_order_release);
+            // The stores must not pass the loads below
+            atomic_thread_fence(memory_order_seq_cst);
+            Spin spin;
+            while (desires[!id].load(memory_order_acquire) && turn.load(memory_order_acquire) == !id)
+                spin.wait();
+        }
+        else {
+            desires[id].store(true);
+            turn.store(!id);
+            Spin spin;
+            while (desires[!id].load() && turn.load() == !id)
+                spin.wait();
+        }
+        holder_id = id;
+    }
+
+    void unlock() {
+        int id = holder_id;
+        desires[id].store(false, Rel ? memory_order_release : memory_order_seq_cst);
+        id_used[id].store(false, memory_order_release);
+    }
+};
+
+class alignas(CACHE_LINE_SIZE) posix_mutex {
+private:
+    pthread_mutex_t m;
+
+public:
+    posix_mutex() { pthread_mutex_init(&m, NULL); }
+    ~posix_mutex() { pthread_mutex_destroy(&m); }
+    posix_mutex(const posix_mutex&) = delete;
+    posix_mutex& operator=(const posix_mutex&) = delete;
+    void lock() { pthread_mutex_lock(&m); }
+    void unlock() { pthread_mutex_unlock(&m); }
+};
+
+// Bounds of the spin phase of adaptive_mutex, in ns
+#define ADAPTIVE_MIN_SPIN_NS 100
+#define ADAPTIVE_MAX_SPIN_NS 20000
+
+// Spin-then-park lock. A contender spins for a budget of twice the recent average hold time
+// (kept within the bounds above), since a holder that is about to leave is cheaper to wait
+// for than a sleep; after that it parks on the state word with a futex. The state is 0 free,
+// 1 held and 2 held with parked waiters, only unlocking a 2 costs a wake-up system call.
+// One acquisition in hold_sample_every samples its hold time into the average.
+class alignas(CACHE_LINE_SIZE) adaptive_mutex {
+private:
+    static constexpr uint32_t hold_sample_every = 16;
+    atomic<uint32_t> state{0};
+    atomic<uint32_t> avg_hold_ns{0};
+    uint32_t acquisitions = 0; // Written and read by the holder only
+    long hold_start_ns = 0;
+
+    static long now_ns() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void futex(atomic<uint32_t>* addr, int op, uint32_t val) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, nullptr, nullptr, 0);
+    }
+
+    long spin_budget_ns() const {
+        long budget = 2L * avg_hold_ns.load(memory_order_relaxed);
+        return min<long>(max<long>(budget, ADAPTIVE_MIN_SPIN_NS), ADAPTIVE_MAX_SPIN_NS);
+    }
+
+    bool try_spin() {
+        long deadline = now_ns() + spin_budget_ns();
+        for (uint32_t i = 1; ; i++) {
+            uint32_t c = state.load(memory_order_relaxed);
+            if (c == 0 && state.compare_exchange_weak(c, 1, memory_order_acquire, memory_order_relaxed))
+                return true;
+            cpu_relax();
+            // The clock only every few rounds, it costs more than a pause
+            if (i % 16 == 0 && now_ns() >= deadline)
+                return false;
+        }
+    }
+
+    void acquired() {
+        hold_start_ns = (++acquisitions % hold_sample_every == 0) ? now_ns() : 0;
+    }
+
+public:
+    void lock() {
+        uint32_t c = 0;
+        if (!state.compare_exchange_strong(c, 1, memory_order_acquire, memory_order_relaxed) && !try_spin()) {
+            // Mark the lock as having sleepers before every sleep, the waker cannot tell
+            // whether others are still parked
+            c = state.exchange(2, memory_order_acquire);
+            while (c != 0) {
+                futex(&state, FUTEX_WAIT_PRIVATE, 2);
+                c = state.exchange(2, memory_order_acquire);
+            }
+        }
+        acquired();
+    }
+
+    void unlock() {
+        if (hold_start_ns != 0) {
+            long hold = now_ns() - hold_start_ns;
+            uint32_t avg = avg_hold_ns.load(memory_order_relaxed);
+            avg_hold_ns.store((uint32_t)min<long>((7L * avg + hold) / 8, UINT32_MAX), memory_order_relaxed);
+        }
+        if (state.exchange(0, memory_order_release) == 2)
+            futex(&state, FUTEX_WAKE_PRIVATE, 1);
+    }
+
+    // Average sampled hold time, in ns
+    uint32_t average_hold_ns() const { return avg_hold_ns.load(memory_order_relaxed); }
+};
+
+// Cohort lock: a local lock per socket under one global lock. The holder hands the global lock
+// on to a waiter of its own socket, at most max_passes times in a row, so the lock and the data
+// it guards mostly stay in the caches of one socket. Global must allow any thread to release it.
+template<class Local, class Global = ticket_mutex<true>>
+class alignas(CACHE_LINE_SIZE) cohort_mutex {
+private:
+    static constexpr int max_passes = 64;
+
+    class alignas(CACHE_LINE_SIZE) cohort {
+    public:
+        Local lock;
+        atomic<int> waiting{0};
+        bool global_held = false; // Guarded by the local lock
+        int passes = 0;
+    };
+
+    Global global;
+    unique_ptr<cohort[]> cohorts;
+    int holder_socket = 0; // Written and read by the holder only
+
+public:
+    cohort_mutex() : cohorts(new cohort[lock_sockets()]) {}
+
+    void lock() {
+        int s = this_thread_socket();
+        cohort& c = cohorts[s];
+        c.waiting.fetch_add(1, memory_order_relaxed);
+        c.lock.lock();
+        c.waiting.fetch_sub(1, memory_order_relaxed);
+        if (!c.global_held) {
+            global.lock();
+            c.global_held = true;
+        }
+        holder_socket = s;
+    }
+
+    void unlock() {
+        cohort& c = cohorts[holder_socket];
+        if (c.waiting.load(memory_order_relaxed) > 0 && c.passes < max_passes) {
+            c.passes++; // The next local holder finds the global lock held
+        }
+        else {
+            c.passes = 0;
+            c.global_held = false;
+            global.unlock();
+        }
+        c.lock.unlock();
+    }
+};
+
+// Lock class of each locks_type kind
+template<locks_type Type> class lock_of { public: using type = posix_mutex; };
+template<> class lock_of<TAS_LOCK> { public: using type = tas_mutex<false>; };
+template<> class lock_of<TTAS_LOCK> { public: using type = ttas_mutex<false>; };
+template<> class lock_of<TICKET_LOCK> { public: using type = ticket_mutex<false>; };
+template<> class lock_of<MCS_LOCK> { public: using type = mcs_mutex<false>; };
+template<> class lock_of<PETERSON_LOCK> { public: using type = peterson_mutex<false>; };
+template<> class lock_of<TASREL_LOCK> { public: using type = tas_mutex<true>; };
+template<> class lock_of<TTASREL_LOCK> { public: using type = ttas_mutex<true>; };
+template<> class lock_of<TICKETREL_LOCK> { public: using type = ticket_mutex<true>; };
+template<> class lock_of<MCSREL_LOCK> { public: using type = mcs_mutex<true>; };
+template<> class lock_of<PETERSONREL_LOCK> { public: using type = peterson_mutex<true>; };
+template<> class lock_of<CLH_LOCK> { public: using type = clh_mutex<false>; };
+template<> class lock_of<CLHREL_LOCK> { public: using type = clh_mutex<true>; };
+template<> class lock_of<COHORT_TTAS_LOCK> { public: using type = cohort_mutex<ttas_mutex<true>>; };
+template<> class lock_of<COHORT_MCS_LOCK> { public: using type = cohort_mutex<mcs_mutex<true>>; };
+template<> class lock_of<ADAPTIVE_LOCK> { public: using type = adaptive_mutex; };
+
+// Calls f.template operator()<Type>() with the runtime kind as a template argument
+template<class F>
+auto with_lock_type(locks_type type, F&& f) {
+    switch (type) {
+        case TAS_LOCK:
+            return f.template operator()<TAS_LOCK>();
+        case TTAS_LOCK:
+            return f.template operator()<TTAS_LOCK>();
+        case TICKET_LOCK:
+            return f.template operator()<TICKET_LOCK>();
+        case MCS_LOCK:
+            return f.template operator()<MCS_LOCK>();
+        case PETERSON_LOCK:
+            return f.template operator()<PETERSON_LOCK>();
+        case TASREL_LOCK:
+            return f.template operator()<TASREL_LOCK>();
+        case TTASREL_LOCK:
+            return f.template operator()<TTASREL_LOCK>();
+        case TICKETREL_LOCK:
+            return f.template operator()<TICKETREL_LOCK>();
+        case MCSREL_LOCK:
+            return f.template operator()<MCSREL_LOCK>();
+        case PETERSONREL_LOCK:
+            return f.template operator()<PETERSONREL_LOCK>();
+        case CLH_LOCK:
+            return f.template operator()<CLH_LOCK>();
+        case CLHREL_LOCK:
+            return f.template operator()<CLHREL_LOCK>();
+        case COHORT_TTAS_LOCK:
+            return f.template operator()<COHORT_TTAS_LOCK>();
+        case COHORT_MCS_LOCK:
+            return f.template operator()<COHORT_MCS_LOCK>();
+        case ADAPTIVE_LOCK:
+            return f.template operator()<ADAPTIVE_LOCK>();
+        case PTHREAD_LOCK:
+        default:
+            return f.template operator()<PTHREAD_LOCK>();
+    }
+}
+
+// The runtime selection for the command line: calls f.template operator()<Lock>() with the
+// lock class of the given kind, so the container is compiled against that class.
+template<class F>
+auto with_lock(locks_type type, F&& f) {
+    return with_lock_type(type, [&]<locks_type Type>() {
+        return f.template operator()<typename lock_of<Type>::type>();
+    });
+}
+
+// Same with the switch based locks_lock adapter, for comparison. Only for the kinds
+// has_switch_lock() is true for.
+template<class F>
+auto with_switch_lock(locks_type type, F&& f) {
+    return with_lock_type(type, [&]<locks_type Type>() {
+        return f.template operator()<locks_lock<Type>>();
+    });
+}
+
+// Peterson locks are only correct with two contenders
+static inline bool is_two_thread_lock(locks_type type) {
+    return type == PETERSON_LOCK || type == PETERSONREL_LOCK;
+}
+
 #endif
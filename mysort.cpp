@@ -18,10 +18,29 @@ using namespace std;
 string input_file = "";
 bool print_name = false;
 int num_threads = 0;
+int bench_iters = 1000;
+reclaim_type reclaim_scheme = RECLAIM_HP;
+bool reclaim_given = false;
+int batch_size = 1;
+backoff_type backoff_scheme = BACKOFF_NONE;
+bool backoff_given = false;
+size_t ring_capacity = 1024;
+locks_type lock_scheme = PTHREAD_LOCK;
+bool lock_given = false;
+int num_shards = 1;
+long eli_wait_ns = 10000;
 
 typedef enum{
     TREIBER_STACK = 0,
+    TREIBER_STACK_TAGGED,
     M_and_S_QUEUE,
+    TWO_LOCK_QUEUE,
+    FAA_QUEUE,
+    KP_QUEUE,
+    MPMC_RING,
+    SPSC_RING,
+    TREIBER_STACK_INTRUSIVE,
+    M_and_S_QUEUE_INTRUSIVE,
     SGL_STACK,
     SGL_QUEUE,
     TREIBER_STACK_ELI,
@@ -33,6 +52,31 @@ typedef enum{
 
 container_type container = TREIBER_STACK;
 
+typedef enum{
+    NO_BENCH = 0,
+    RECLAIM_BENCH,
+    ABA_BENCH,
+    BATCH_BENCH,
+    SCALING_BENCH,
+    INTRUSIVE_BENCH,
+    BOUNDED_BENCH,
+    SPSC_BENCH,
+    LATENCY_BENCH,
+    WAIT_BENCH,
+    LOCK_BENCH,
+    DEPTH_BENCH,
+    SHARDS_BENCH,
+    SGL_LOCK_BENCH,
+    DISPATCH_BENCH,
+    QUEUE_LOCK_BENCH,
+    OVERSUB_BENCH,
+    BARRIER_BENCH,
+    ELIMINATION_BENCH,
+    ELI_LATENCY_BENCH
+}bench_type;
+
+bench_type bench = NO_BENCH;
+
 
 // Command-line argument processing and main function as before
 /**
@@ -44,12 +88,21 @@ container_type container = TREIBER_STACK;
  */
 void process_args(int argc, char* argv[]){
 
-    const char* const short_args = "i:t:c:";
+    const char* const short_args = "i:t:c:b:n:r:k:o:q:l:s:w:";
     const option long_args[] = {
         {"name", no_argument, nullptr, 'x'},
         {"input", required_argument, nullptr, 'i'},          // for input text file
         {"num_threads", required_argument, nullptr, 't'},     // for the number of threads
         {"container", required_argument, nullptr, 'c'},        // for container
+        {"bench", required_argument, nullptr, 'b'},            // for benchmark
+        {"iterations", required_argument, nullptr, 'n'},       // for benchmark iterations
+        {"reclaim", required_argument, nullptr, 'r'},          // for memory reclamation scheme
+        {"batch", required_argument, nullptr, 'k'},            // for treiber push_range/pop_n batch size
+        {"backoff", required_argument, nullptr, 'o'},          // for CAS retry backoff policy
+        {"capacity", required_argument, nullptr, 'q'},         // for bounded ring capacity
+        {"lock", required_argument, nullptr, 'l'},             // for the lock of the lock based containers
+        {"shards", required_argument, nullptr, 's'},           // for the number of sgl shards
+        {"eli_wait", required_argument, nullptr, 'w'},         // for the elimination wait in ns
         {nullptr, no_argument, nullptr, 0}
     };
 
@@ -76,8 +129,24 @@ void process_args(int argc, char* argv[]){
             case 'c':
                 if(strcmp(optarg, "treiber") == 0)
                     container = TREIBER_STACK;
+                else if(strcmp(optarg, "treiber_tagged") == 0)
+                    container = TREIBER_STACK_TAGGED;
                 else if(strcmp(optarg, "m_and_s") == 0)
                     container = M_and_S_QUEUE;
+                else if(strcmp(optarg, "two_lock") == 0)
+                    container = TWO_LOCK_QUEUE;
+                else if(strcmp(optarg, "faa_queue") == 0)
+                    container = FAA_QUEUE;
+                else if(strcmp(optarg, "kp_queue") == 0)
+                    container = KP_QUEUE;
+                else if(strcmp(optarg, "mpmc_ring") == 0)
+                    container = MPMC_RING;
+                else if(strcmp(optarg, "spsc_ring") == 0)
+                    container = SPSC_RING;
+                else if(strcmp(optarg, "treiber_intrusive") == 0)
+                    container = TREIBER_STACK_INTRUSIVE;
+                else if(strcmp(optarg, "m_and_s_intrusive") == 0)
+                    container = M_and_S_QUEUE_INTRUSIVE;
                 else if(strcmp(optarg, "sgl_stack") == 0)
                     container = SGL_STACK;
                 else if(strcmp(optarg, "sgl_queue") == 0)
@@ -95,6 +164,100 @@ void process_args(int argc, char* argv[]){
                 else
                     container = TREIBER_STACK;
                 break;
+
+            case 'b':
+                if(strcmp(optarg, "reclaim") == 0)
+                    bench = RECLAIM_BENCH;
+                else if(strcmp(optarg, "aba") == 0)
+                    bench = ABA_BENCH;
+                else if(strcmp(optarg, "batch") == 0)
+                    bench = BATCH_BENCH;
+                else if(strcmp(optarg, "scaling") == 0)
+                    bench = SCALING_BENCH;
+                else if(strcmp(optarg, "intrusive") == 0)
+                    bench = INTRUSIVE_BENCH;
+                else if(strcmp(optarg, "bounded") == 0)
+                    bench = BOUNDED_BENCH;
+                else if(strcmp(optarg, "spsc") == 0)
+                    bench = SPSC_BENCH;
+                else if(strcmp(optarg, "latency") == 0)
+                    bench = LATENCY_BENCH;
+                else if(strcmp(optarg, "wait") == 0)
+                    bench = WAIT_BENCH;
+                else if(strcmp(optarg, "locks") == 0)
+                    bench = LOCK_BENCH;
+                else if(strcmp(optarg, "depth") == 0)
+                    bench = DEPTH_BENCH;
+                else if(strcmp(optarg, "shards") == 0)
+                    bench = SHARDS_BENCH;
+                else if(strcmp(optarg, "sgl_locks") == 0)
+                    bench = SGL_LOCK_BENCH;
+                else if(strcmp(optarg, "dispatch") == 0)
+                    bench = DISPATCH_BENCH;
+                else if(strcmp(optarg, "queue_locks") == 0)
+                    bench = QUEUE_LOCK_BENCH;
+                else if(strcmp(optarg, "oversub") == 0)
+                    bench = OVERSUB_BENCH;
+                else if(strcmp(optarg, "barriers") == 0)
+                    bench = BARRIER_BENCH;
+                else if(strcmp(optarg, "elimination") == 0)
+                    bench = ELIMINATION_BENCH;
+                else if(strcmp(optarg, "eli_latency") == 0)
+                    bench = ELI_LATENCY_BENCH;
+                else
+                    bench = NO_BENCH;
+                break;
+
+            case 'n':
+                bench_iters = atoi(optarg);
+                break;
+
+            case 'k':
+                batch_size = max(atoi(optarg), 1);
+                break;
+
+            case 'r':
+                reclaim_given = true;
+                if(strcmp(optarg, "none") == 0)
+                    reclaim_scheme = RECLAIM_NONE;
+                else if(strcmp(optarg, "ebr") == 0)
+                    reclaim_scheme = RECLAIM_EBR;
+                else
+                    reclaim_scheme = RECLAIM_HP;
+                break;
+
+            case 'q':
+                ring_capacity = max(atol(optarg), 2L);
+                break;
+
+            case 's':
+                num_shards = max(atoi(optarg), 1);
+                break;
+
+            case 'w':
+                eli_wait_ns = max(atol(optarg), 0L);
+                break;
+
+            case 'l':
+                lock_given = true;
+                lock_scheme = PTHREAD_LOCK;
+                for(int l = PTHREAD_LOCK; l < NO_LOCK; l++){
+                    if(strcmp(optarg, lock_name((locks_type)l)) == 0)
+                        lock_scheme = (locks_type)l;
+                }
+                break;
+
+            case 'o':
+                backoff_given = true;
+                if(strcmp(optarg, "exp") == 0)
+                    backoff_scheme = BACKOFF_EXP;
+                else if(strcmp(optarg, "pause") == 0)
+                    backoff_scheme = BACKOFF_PAUSE;
+                else if(strcmp(optarg, "adaptive") == 0)
+                    backoff_scheme = BACKOFF_ADAPTIVE;
+                else
+                    backoff_scheme = BACKOFF_NONE;
+                break;
  
             default:
                 break;
@@ -133,47 +296,238 @@ int main(int argc, char* argv[]) {
         read_array.push_back(value);
 
     input_file_var.close();
+
+    if(bench != NO_BENCH){
+        switch(bench){
+            case RECLAIM_BENCH:
+                // Peak RSS only grows within a process, run one scheme per process (-r) to compare it
+                cout << "| Container | Reclamation | Threads | Ops/sec | Peak RSS (KB) |" << endl;
+                cout << "|-----------|-------------|---------|---------|---------------|" << endl;
+                for(reclaim_type r : {RECLAIM_NONE, RECLAIM_HP, RECLAIM_EBR}){
+                    if(reclaim_given && r != reclaim_scheme)
+                        continue;
+                    tstack_reclaim_bench(num_threads, read_array, bench_iters, r);
+                    msqueue_reclaim_bench(num_threads, read_array, bench_iters, r);
+                    faaqueue_reclaim_bench(num_threads, read_array, bench_iters, r);
+                }
+                break;
+
+            case ABA_BENCH:
+                tstack_aba_bench(num_threads, read_array, bench_iters);
+                break;
+
+            case BATCH_BENCH:
+                tstack_batch_bench(num_threads, read_array, bench_iters, reclaim_scheme);
+                break;
+
+            case SCALING_BENCH:{
+                // 2, 4, 8, ... threads up to the given count
+                vector<int> thread_counts;
+                for(int t = 2; t < num_threads; t *= 2)
+                    thread_counts.push_back(t);
+                thread_counts.push_back(max(num_threads, 2));
+
+                cout << "| Container | Backoff | Threads | Ops/sec |" << endl;
+                cout << "|-----------|---------|---------|---------|" << endl;
+                for(backoff_type b : {BACKOFF_NONE, BACKOFF_EXP, BACKOFF_PAUSE, BACKOFF_ADAPTIVE}){
+                    if(backoff_given && b != backoff_scheme)
+                        continue;
+                    for(int t : thread_counts)
+                        tstack_backoff_bench(t, read_array, bench_iters, reclaim_scheme, b);
+                    for(int t : thread_counts)
+                        msqueue_backoff_bench(t, read_array, bench_iters, reclaim_scheme, b);
+                }
+                break;
+            }
+
+            case INTRUSIVE_BENCH:
+                cout << "| Container | Reclamation | Threads | Ops/sec | Peak RSS (KB) |" << endl;
+                cout << "|-----------|-------------|---------|---------|---------------|" << endl;
+                tstack_reclaim_bench(num_threads, read_array, bench_iters, reclaim_scheme);
+                msqueue_reclaim_bench(num_threads, read_array, bench_iters, reclaim_scheme);
+                intrusive_reclaim_bench(num_threads, read_array, bench_iters, reclaim_scheme);
+                break;
+
+            case BOUNDED_BENCH:
+                cout << "| Container | Capacity | Threads | Ops/sec | Peak RSS (KB) |" << endl;
+                cout << "|-----------|----------|---------|---------|---------------|" << endl;
+                mpmc_ring_bench(num_threads, read_array, bench_iters, ring_capacity);
+                msqueue_bench(num_threads, read_array, bench_iters);
+                sgl_queue_bench(num_threads, read_array, bench_iters);
+                break;
+
+            case SPSC_BENCH:
+                // One producer and one consumer whatever -t says
+                cout << "| Container | Capacity | Threads | Ops/sec | Peak RSS (KB) |" << endl;
+                cout << "|-----------|----------|---------|---------|---------------|" << endl;
+                spsc_ring_bench(read_array, bench_iters, ring_capacity);
+                mpmc_ring_bench(2, read_array, bench_iters, ring_capacity);
+                msqueue_bench(2, read_array, bench_iters);
+                break;
+
+            case LATENCY_BENCH:
+                cout << "| Container | Threads | p50 (ns) | p99 (ns) | p99.9 (ns) | max (ns) |" << endl;
+                cout << "|-----------|---------|----------|----------|------------|----------|" << endl;
+                kpqueue_latency_bench(num_threads, read_array, bench_iters);
+                msqueue_latency_bench(num_threads, read_array, bench_iters, reclaim_scheme);
+                break;
+
+            case WAIT_BENCH:
+                // -n is the number of wake-ups timed per row
+                cout << "| Container | Consumers | Threads | Idle CPU (%) | Wake p50 (ns) | Wake max (ns) |" << endl;
+                cout << "|-----------|-----------|---------|--------------|---------------|---------------|" << endl;
+                tstack_wait_bench(num_threads, bench_iters);
+                msqueue_wait_bench(num_threads, bench_iters);
+                break;
+
+            case LOCK_BENCH:
+                cout << "| Container | Lock | Threads | Ops/sec |" << endl;
+                cout << "|-----------|------|---------|---------|" << endl;
+                for(int l = PTHREAD_LOCK; l < NO_LOCK; l++){
+                    if(lock_given && l != lock_scheme)
+                        continue;
+                    tlqueue_lock_bench(num_threads, read_array, bench_iters, (locks_type)l);
+                }
+                break;
+
+            case DEPTH_BENCH:
+                sgl_queue_depth_bench(num_threads, read_array, bench_iters);
+                break;
+
+            case SHARDS_BENCH:
+                sgl_shards_bench(num_threads, read_array, bench_iters);
+                break;
+
+            case SGL_LOCK_BENCH:
+                sgl_lock_bench(num_threads, read_array, bench_iters, lock_scheme, lock_given);
+                break;
+
+            case DISPATCH_BENCH:
+                lock_dispatch_bench(num_threads, read_array, bench_iters, lock_scheme, lock_given);
+                break;
+
+            case QUEUE_LOCK_BENCH:
+                queue_lock_bench(num_threads, bench_iters, lock_scheme, lock_given);
+                break;
+
+            case OVERSUB_BENCH:
+                // Thread counts follow the number of cores, -t is not used
+                oversubscription_bench(bench_iters, lock_scheme, lock_given);
+                break;
+
+            case BARRIER_BENCH:
+                barrier_bench(num_threads, bench_iters);
+                break;
+
+            case ELIMINATION_BENCH:
+                elimination_bench(num_threads, bench_iters, eli_wait_ns);
+                break;
+
+            case ELI_LATENCY_BENCH:
+                e_tstack_latency_bench(num_threads, read_array, bench_iters, reclaim_scheme, eli_wait_ns);
+                break;
+
+            default:
+                break;
+        }
+        return 0;
+    }
+
     switch(container){
         case TREIBER_STACK:
-            if(tstack_test_advanced(num_threads, read_array) != 0){
+            if(tstack_test_advanced(num_threads, read_array, reclaim_scheme, backoff_scheme, batch_size) != 0){
                 cout<<"Treiber test with multiple threads failing"<<endl;
                 fail = true;
             }
 
             break;
+
+        case TREIBER_STACK_TAGGED:
+            if(tagged_tstack_test_advanced(num_threads, read_array) != 0){
+                cout<<"Tagged Treiber test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
         
         case M_and_S_QUEUE:
-            if(msqueue_test_advanced(num_threads, read_array) != 0){
+            if(msqueue_test_advanced(num_threads, read_array, reclaim_scheme, backoff_scheme) != 0){
                 cout<<"msqueue test with multiple threads failing"<<endl;
                 fail = true;
             }            
             break;
         
+        case TWO_LOCK_QUEUE:
+            if(tlqueue_test_advanced(num_threads, read_array, lock_scheme) != 0){
+                cout<<"two lock queue test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
+
+        case FAA_QUEUE:
+            if(faaqueue_test_advanced(num_threads, read_array, reclaim_scheme) != 0){
+                cout<<"FAA queue test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
+
+        case KP_QUEUE:
+            if(kpqueue_test_advanced(num_threads, read_array) != 0){
+                cout<<"KP queue test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
+
+        case MPMC_RING:
+            if(mpmc_ring_test_advanced(num_threads, read_array, ring_capacity) != 0){
+                cout<<"MPMC ring test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
+
+        case SPSC_RING:
+            if(spsc_ring_test_advanced(num_threads, read_array, ring_capacity) != 0){
+                cout<<"SPSC ring test failing"<<endl;
+                fail = true;
+            }
+            break;
+
+        case TREIBER_STACK_INTRUSIVE:
+            if(intrusive_tstack_test_advanced(num_threads, read_array, reclaim_scheme) != 0){
+                cout<<"Intrusive Treiber test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
+
+        case M_and_S_QUEUE_INTRUSIVE:
+            if(intrusive_msqueue_test_advanced(num_threads, read_array, reclaim_scheme) != 0){
+                cout<<"Intrusive msqueue test with multiple threads failing"<<endl;
+                fail = true;
+            }
+            break;
+
         case TREIBER_STACK_ELI:
-            init_eli();
-            if(e_tstack_test_advanced(num_threads, read_array) != 0){
+            if(e_tstack_test_advanced(num_threads, read_array, reclaim_scheme, eli_wait_ns) != 0){
                 cout<<"Tstack fails in elimination"<<endl;
                 fail = true;
             }
             break;
            
         case SGL_STACK_ELI:
-            init_eli();
-            if(e_sgl_stack_test_advanced(num_threads, read_array) != 0){
+            if(e_sgl_stack_test_advanced(num_threads, read_array, eli_wait_ns) != 0){
                 cout<<"SGL stack elimination test with multiple threads failing"<<endl;
                 fail = true;
             }   
             break;
             
         case SGL_STACK:
-            if(sgl_stack_test_advanced(num_threads, read_array) != 0){
+            if(sgl_stack_test_advanced(num_threads, read_array, num_shards, lock_scheme) != 0){
                 cout<<"SGL stack test with multiple threads failing"<<endl;
                 fail = true;
             }   
             break;
         
         case SGL_QUEUE:
-            if(sgl_queue_test_advanced(num_threads, read_array) != 0){
+            if(sgl_queue_test_advanced(num_threads, read_array, num_shards, lock_scheme) != 0){
                 cout<<"SGL queue test with multiple threads failing"<<endl;
                 fail = true;
             }   
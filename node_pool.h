@@ -0,0 +1,201 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+#define CACHE_LINE_SIZE 64
+
+// Number of free nodes a thread keeps in one magazine before handing it to the depot.
+#define POOL_MAGAZINE_SIZE 64
+
+// Size of one slab carved into nodes, a multiple of the cache line size.
+#define POOL_SLAB_BYTES (64 * 1024)
+
+// Arena for the nodes of one container node type.
+// Every thread caches free nodes in two magazines and only takes the depot lock to swap
+// a whole magazine, so allocation and free are a few private loads and stores.
+// Slabs are never handed back to malloc, which keeps node memory type stable for the
+// lifetime of the process.
+template<class N>
+class node_pool {
+private:
+    class free_slot {
+    public:
+        free_slot* next;
+    };
+
+    class magazine {
+    public:
+        free_slot* head = nullptr;
+        int count = 0;
+
+        void push(void* p) {
+            free_slot* s = static_cast<free_slot*>(p);
+            s->next = head;
+            head = s;
+            count++;
+        }
+
+        void* pop() {
+            free_slot* s = head;
+            head = s->next;
+            count--;
+            return s;
+        }
+    };
+
+    // Per thread cache. It is trivially destructible so that nodes freed by other thread
+    // exit handlers (retire lists) still find valid memory; those go straight to the depot.
+    class local_cache {
+    public:
+        magazine loaded;
+        magazine previous;
+        bool registered = false;
+        bool exited = false;
+    };
+
+    // Returns the cache of the exiting thread to the depot
+    class cache_reaper {
+    public:
+        ~cache_reaper() {
+            local_cache& c = cache();
+            node_pool& pool = instance();
+            lock_guard<mutex> lock(pool.depot_lock);
+            if (c.loaded.count != 0)
+                pool.depot.push_back(c.loaded);
+            if (c.previous.count != 0)
+                pool.depot.push_back(c.previous);
+            c.loaded = magazine();
+            c.previous = magazine();
+            c.exited = true;
+        }
+    };
+
+    static constexpr size_t slot_size =
+        ((sizeof(N) > sizeof(free_slot) ? sizeof(N) : sizeof(free_slot)) + alignof(N) - 1) / alignof(N) * alignof(N);
+
+    // Nodes larger than a slab (e.g. queue segments) get a slab of their own
+    static constexpr size_t slab_bytes = slot_size > POOL_SLAB_BYTES ?
+        (slot_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE : POOL_SLAB_BYTES;
+
+    mutex depot_lock;
+    vector<magazine> depot;
+    vector<void*> slabs;
+
+    node_pool() {}
+
+    static local_cache& cache() {
+        static thread_local local_cache c;
+        if (!c.registered) {
+            c.registered = true;
+            static thread_local cache_reaper reaper;
+            (void)reaper;
+        }
+        return c;
+    }
+
+    // Carves a new cache line aligned slab into full magazines; called with depot_lock held
+    void grow() {
+        void* slab = aligned_alloc(CACHE_LINE_SIZE, slab_bytes);
+        if (slab == nullptr)
+            throw bad_alloc();
+        slabs.push_back(slab);
+
+        char* p = static_cast<char*>(slab);
+        size_t nodes = slab_bytes / slot_size;
+        magazine m;
+        for (size_t i = 0; i < nodes; i++) {
+            m.push(p + i * slot_size);
+            if (m.count == POOL_MAGAZINE_SIZE) {
+                depot.push_back(m);
+                m = magazine();
+            }
+        }
+        if (m.count != 0)
+            depot.push_back(m);
+    }
+
+    magazine take_full() {
+        lock_guard<mutex> lock(depot_lock);
+        if (depot.empty())
+            grow();
+        magazine m = depot.back();
+        depot.pop_back();
+        return m;
+    }
+
+    void give_full(const magazine& m) {
+        lock_guard<mutex> lock(depot_lock);
+        depot.push_back(m);
+    }
+
+public:
+    // Never destroyed, nodes can still be retired while other static objects are torn down
+    static node_pool& instance() {
+        static node_pool* pool = new node_pool();
+        return *pool;
+    }
+
+    void* allocate() {
+        local_cache& c = cache();
+        if (c.loaded.count == 0) {
+            if (c.previous.count != 0)
+                swap(c.loaded, c.previous);
+            else
+                c.loaded = take_full();
+        }
+        return c.loaded.pop();
+    }
+
+    void deallocate(void* p) {
+        local_cache& c = cache();
+        if (c.exited) {
+            magazine m;
+            m.push(p);
+            give_full(m);
+            return;
+        }
+        if (c.loaded.count == POOL_MAGAZINE_SIZE) {
+            if (c.previous.count != 0)
+                give_full(c.previous);
+            c.previous = c.loaded;
+            c.loaded = magazine();
+        }
+        c.loaded.push(p);
+    }
+
+    // Prefills the depot so that at least n nodes can be allocated without growing
+    void reserve(size_t n) {
+        lock_guard<mutex> lock(depot_lock);
+        size_t available = 0;
+        for (auto& m : depot)
+            available += m.count;
+        while (available < n) {
+            size_t before = depot.size();
+            grow();
+            for (size_t i = before; i < depot.size(); i++)
+                available += depot[i].count;
+        }
+    }
+};
+
+// Base class routing new/delete of a node type through its node_pool
+template<class N>
+class pooled {
+public:
+    static void* operator new(size_t size) {
+        return node_pool<N>::instance().allocate();
+    }
+
+    static void operator delete(void* p) {
+        node_pool<N>::instance().deallocate(p);
+    }
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include "reclamation.h"
+
+// Per thread hazard pointer state, handed back to the domain when the thread exits.
+class hp_thread_state {
+public:
+    hp_domain::hp_record* rec = nullptr;
+    vector<hp_domain::retired_node> retired;
+
+    ~hp_thread_state() {
+        if (rec != nullptr)
+            hp_domain::instance().release_record(rec, retired);
+    }
+};
+
+static thread_local hp_thread_state hp_state;
+
+hp_domain& hp_domain::instance() {
+    static hp_domain domain;
+    return domain;
+}
+
+hp_domain::~hp_domain() {
+    for (auto& r : orphans)
+        r.deleter(r.ptr);
+
+    hp_record* rec = head.load(memory_order_acquire);
+    while (rec != nullptr) {
+        hp_record* next = rec->next;
+        delete rec;
+        rec = next;
+    }
+}
+
+hp_domain::hp_record* hp_local_record() {
+    if (hp_state.rec == nullptr)
+        hp_state.rec = hp_domain::instance().acquire_record();
+    return hp_state.rec;
+}
+
+hp_domain::hp_record* hp_domain::acquire_record() {
+    // Reuse a record released by an exited thread
+    for (hp_record* rec = head.load(memory_order_acquire); rec != nullptr; rec = rec->next) {
+        bool expected = false;
+        if (!rec->active.load(memory_order_relaxed) &&
+            rec->active.compare_exchange_strong(expected, true, memory_order_acq_rel))
+            return rec;
+    }
+
+    hp_record* rec = new hp_record();
+    hp_record* old_head = head.load(memory_order_relaxed);
+    do {
+        rec->next = old_head;
+    } while (!head.compare_exchange_weak(old_head, rec, memory_order_acq_rel));
+    num_records.fetch_add(1, memory_order_relaxed);
+    return rec;
+}
+
+void hp_domain::release_record(hp_record* rec, vector<retired_node>& retired) {
+    for (int i = 0; i < HP_PER_THREAD; i++)
+        rec->hazard[i].store(nullptr, memory_order_release);
+
+    scan(retired);
+    if (!retired.empty()) {
+        lock_guard<mutex> lock(orphan_lock);
+        orphans.insert(orphans.end(), retired.begin(), retired.end());
+        has_orphans.store(true, memory_order_release);
+        retired.clear();
+    }
+    rec->active.store(false, memory_order_release);
+}
+
+void hp_domain::retire(void* ptr, void (*deleter)(void*)) {
+    vector<retired_node>& retired = hp_state.retired;
+    retired.push_back({ptr, deleter});
+
+    // Scanning only once the list outgrows the total number of hazard pointers
+    // keeps the cost of a retire amortized constant.
+    size_t threshold = max<size_t>(HP_SCAN_THRESHOLD,
+                                   2 * HP_PER_THREAD * num_records.load(memory_order_relaxed));
+    if (retired.size() >= threshold)
+        scan(retired);
+}
+
+void hp_domain::scan(vector<retired_node>& retired) {
+    if (has_orphans.load(memory_order_acquire)) {
+        lock_guard<mutex> lock(orphan_lock);
+        retired.insert(retired.end(), orphans.begin(), orphans.end());
+        orphans.clear();
+        has_orphans.store(false, memory_order_release);
+    }
+
+    // Pairs with the seq_cst store in hp_reclaim::guard::protect
+    atomic_thread_fence(memory_order_seq_cst);
+
+    vector<void*> hazards;
+    for (hp_record* rec = head.load(memory_order_acquire); rec != nullptr; rec = rec->next) {
+        for (int i = 0; i < HP_PER_THREAD; i++) {
+            void* p = rec->hazard[i].load(memory_order_acquire);
+            if (p != nullptr)
+                hazards.push_back(p);
+        }
+    }
+    sort(hazards.begin(), hazards.end());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); i++) {
+        if (binary_search(hazards.begin(), hazards.end(), retired[i].ptr))
+            retired[kept++] = retired[i];
+        else
+            retired[i].deleter(retired[i].ptr);
+    }
+    retired.resize(kept);
+}
+
+void hp_domain::drain() {
+    // Adopts the orphans, no hazard pointer is set so everything is freed
+    scan(hp_state.retired);
+}
+
+const char* reclaim_name(reclaim_type type) {
+    switch (type) {
+        case RECLAIM_NONE:
+            return "none";
+        case RECLAIM_EBR:
+            return "epochs";
+        case RECLAIM_HP:
+        default:
+            return "hazard pointers";
+    }
+}
+
+// Per thread epoch state, handed back to the domain when the thread exits.
+class ebr_thread_state {
+public:
+    ebr_domain::ebr_record* rec = nullptr;
+    ebr_domain::limbo_list limbo[3];
+    uint64_t last_epoch = 0;
+    int nesting = 0;
+    int retire_count = 0;
+
+    ~ebr_thread_state() {
+        if (rec != nullptr)
+            ebr_domain::instance().release_record(rec, limbo);
+    }
+};
+
+static thread_local ebr_thread_state ebr_state;
+
+static void free_limbo(ebr_domain::limbo_list& list) {
+    for (auto& r : list.nodes)
+        r.deleter(r.ptr);
+    list.nodes.clear();
+}
+
+ebr_domain& ebr_domain::instance() {
+    static ebr_domain domain;
+    return domain;
+}
+
+ebr_domain::~ebr_domain() {
+    for (auto& l : orphans)
+        free_limbo(l);
+
+    ebr_record* rec = head.load(memory_order_acquire);
+    while (rec != nullptr) {
+        ebr_record* next = rec->next;
+        delete rec;
+        rec = next;
+    }
+}
+
+ebr_domain::ebr_record* ebr_domain::acquire_record() {
+    // Reuse a record released by an exited thread
+    for (ebr_record* rec = head.load(memory_order_acquire); rec != nullptr; rec = rec->next) {
+        bool expected = false;
+        if (!rec->in_use.load(memory_order_relaxed) &&
+            rec->in_use.compare_exchange_strong(expected, true, memory_order_acq_rel))
+            return rec;
+    }
+
+    ebr_record* rec = new ebr_record();
+    ebr_record* old_head = head.load(memory_order_relaxed);
+    do {
+        rec->next = old_head;
+    } while (!head.compare_exchange_weak(old_head, rec, memory_order_acq_rel));
+    return rec;
+}
+
+void ebr_domain::release_record(ebr_record* rec, limbo_list limbo[3]) {
+    rec->state.store(0, memory_order_release);
+
+    free_expired(limbo, global_epoch.load(memory_order_acquire));
+    lock_guard<mutex> lock(orphan_lock);
+    for (int i = 0; i < 3; i++) {
+        if (!limbo[i].nodes.empty()) {
+            orphans.push_back(move(limbo[i]));
+            limbo[i].nodes.clear();
+            has_orphans.store(true, memory_order_release);
+        }
+    }
+    rec->in_use.store(false, memory_order_release);
+}
+
+void ebr_domain::enter() {
+    ebr_thread_state& st = ebr_state;
+    if (st.rec == nullptr)
+        st.rec = acquire_record();
+    if (st.nesting++ != 0)
+        return;
+
+    uint64_t epoch = global_epoch.load(memory_order_acquire);
+    st.rec->state.store((epoch << 1) | 1, memory_order_relaxed);
+    // The announcement must be visible before any shared pointer is read
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (epoch != st.last_epoch) {
+        st.last_epoch = epoch;
+        free_expired(st.limbo, epoch);
+    }
+}
+
+void ebr_domain::exit() {
+    ebr_thread_state& st = ebr_state;
+    if (--st.nesting == 0)
+        st.rec->state.store(0, memory_order_release);
+}
+
+void ebr_domain::retire(void* ptr, void (*deleter)(void*)) {
+    ebr_thread_state& st = ebr_state;
+    uint64_t epoch = global_epoch.load(memory_order_seq_cst);
+
+    // A list still tagged with an older epoch of the same residue is at least three epochs old
+    limbo_list& list = st.limbo[epoch % 3];
+    if (list.epoch != epoch) {
+        free_limbo(list);
+        list.epoch = epoch;
+    }
+    list.nodes.push_back({ptr, deleter});
+
+    if (++st.retire_count % EBR_BATCH == 0) {
+        try_advance();
+        free_expired(st.limbo, global_epoch.load(memory_order_acquire));
+    }
+}
+
+bool ebr_domain::try_advance() {
+    uint64_t epoch = global_epoch.load(memory_order_acquire);
+    // Pairs with the fence in enter()
+    atomic_thread_fence(memory_order_seq_cst);
+
+    for (ebr_record* rec = head.load(memory_order_acquire); rec != nullptr; rec = rec->next) {
+        uint64_t s = rec->state.load(memory_order_acquire);
+        if ((s & 1) && (s >> 1) != epoch)
+            return false; // a thread is still running in an older epoch
+    }
+    return global_epoch.compare_exchange_strong(epoch, epoch + 1, memory_order_acq_rel);
+}
+
+void ebr_domain::free_expired(limbo_list limbo[3], uint64_t epoch) {
+    for (int i = 0; i < 3; i++) {
+        if (!limbo[i].nodes.empty() && limbo[i].epoch + 2 <= epoch)
+            free_limbo(limbo[i]);
+    }
+
+    if (has_orphans.load(memory_order_acquire)) {
+        lock_guard<mutex> lock(orphan_lock);
+        size_t kept = 0;
+        for (size_t i = 0; i < orphans.size(); i++) {
+            if (orphans[i].epoch + 2 <= epoch)
+                free_limbo(orphans[i]);
+            else if (kept++ != i)
+                orphans[kept - 1] = move(orphans[i]);
+        }
+        orphans.resize(kept);
+        has_orphans.store(kept != 0, memory_order_release);
+    }
+}
+
+void ebr_domain::drain() {
+    // Nobody is inside an operation, so two advances expire every list
+    for (int i = 0; i < 2; i++)
+        try_advance();
+    free_expired(ebr_state.limbo, global_epoch.load(memory_order_acquire));
+}
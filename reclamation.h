@@ -0,0 +1,233 @@
+#ifndef RECLAMATION_H
+#define RECLAMATION_H
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+using namespace std;
+
+typedef enum {
+    RECLAIM_NONE = 0,
+    RECLAIM_HP,
+    RECLAIM_EBR
+} reclaim_type;
+
+// Number of hazard pointers each thread can hold at the same time.
+// The M&S queue needs two (head and head->next), the Treiber stack one for pop and
+// three for pop_n (top plus two alternating while walking down the stack).
+#define HP_PER_THREAD 3
+
+// Minimum number of retired nodes a thread collects before it scans the hazard pointers.
+#define HP_SCAN_THRESHOLD 64
+
+// Number of retires between two attempts of a thread to advance the global epoch.
+#define EBR_BATCH 64
+
+// Hazard pointer domain shared by all the lock free containers.
+// Every thread owns one record with HP_PER_THREAD hazard slots and a private retire list.
+// A retired node is freed only after a scan proves that no record points to it.
+class hp_domain {
+public:
+    class hp_record {
+    public:
+        atomic<void*> hazard[HP_PER_THREAD];
+        atomic<bool> active;
+        hp_record* next;
+
+        hp_record() : active(true), next(nullptr) {
+            for (int i = 0; i < HP_PER_THREAD; i++)
+                hazard[i].store(nullptr, memory_order_relaxed);
+        }
+    };
+
+    class retired_node {
+    public:
+        void* ptr;
+        void (*deleter)(void*);
+    };
+
+private:
+    atomic<hp_record*> head;
+    atomic<int> num_records;
+
+    // Nodes left behind by threads that exited before their retire list could be emptied.
+    mutex orphan_lock;
+    vector<retired_node> orphans;
+    atomic<bool> has_orphans;
+
+public:
+    hp_domain() : head(nullptr), num_records(0), has_orphans(false) {}
+    ~hp_domain();
+
+    static hp_domain& instance();
+
+    hp_record* acquire_record();
+    void release_record(hp_record* rec, vector<retired_node>& retired);
+
+    void retire(void* ptr, void (*deleter)(void*));
+    void scan(vector<retired_node>& retired);
+    // Frees every node retired by the caller and by exited threads. Only valid while no
+    // other thread holds a hazard pointer, e.g. after the workers were joined.
+    void drain();
+};
+
+// Hazard pointer record of the calling thread, acquired on first use.
+hp_domain::hp_record* hp_local_record();
+
+// Epoch based reclamation domain.
+// A thread announces the global epoch while it is inside an operation. Retired nodes go
+// to the limbo list of the epoch they were retired in and the whole list is freed once
+// the global epoch has moved two steps further, since by then every thread that could
+// still hold a reference has left its operation.
+class ebr_domain {
+public:
+    class ebr_record {
+    public:
+        // (announced epoch << 1) | 1 while the thread is inside an operation, 0 otherwise
+        atomic<uint64_t> state;
+        atomic<bool> in_use;
+        ebr_record* next;
+
+        ebr_record() : state(0), in_use(true), next(nullptr) {}
+    };
+
+    class limbo_list {
+    public:
+        uint64_t epoch = 0;
+        vector<hp_domain::retired_node> nodes;
+    };
+
+private:
+    atomic<uint64_t> global_epoch;
+    atomic<ebr_record*> head;
+
+    mutex orphan_lock;
+    vector<limbo_list> orphans;
+    atomic<bool> has_orphans;
+
+public:
+    ebr_domain() : global_epoch(2), head(nullptr), has_orphans(false) {}
+    ~ebr_domain();
+
+    static ebr_domain& instance();
+
+    ebr_record* acquire_record();
+    void release_record(ebr_record* rec, limbo_list limbo[3]);
+
+    void enter();
+    void exit();
+    void retire(void* ptr, void (*deleter)(void*));
+    bool try_advance();
+    void free_expired(limbo_list limbo[3], uint64_t epoch);
+    // Frees every node retired by the caller and by exited threads. Only valid while no
+    // other thread is inside an operation, e.g. after the workers were joined.
+    void drain();
+};
+
+// Reclamation policies used as template parameters of the containers.
+// Every operation creates a guard, protects the shared pointers it dereferences through it
+// and hands unlinked nodes to retire(). Nodes the container does not own (intrusive
+// containers) are retired with their own deleter, which runs once no thread can reach them.
+
+// Baseline: unlinked nodes are never freed.
+class no_reclaim {
+public:
+    class guard {
+    public:
+        template<class N>
+        N* protect(int slot, const atomic<N*>& src) {
+            return src.load(memory_order_acquire);
+        }
+        void clear(int slot) {}
+    };
+
+    template<class N>
+    static void retire(N* n) {}
+    static void retire(void* p, void (*deleter)(void*)) {}
+    static void drain() {}
+};
+
+class ebr_reclaim {
+public:
+    class guard {
+    public:
+        guard() { ebr_domain::instance().enter(); }
+        ~guard() { ebr_domain::instance().exit(); }
+
+        // No per pointer fence: the announced epoch already protects every node reachable
+        // during the operation.
+        template<class N>
+        N* protect(int slot, const atomic<N*>& src) {
+            return src.load(memory_order_acquire);
+        }
+        void clear(int slot) {}
+    };
+
+    template<class N>
+    static void retire(N* n) {
+        ebr_domain::instance().retire(n, [](void* p) { delete static_cast<N*>(p); });
+    }
+    static void retire(void* p, void (*deleter)(void*)) { ebr_domain::instance().retire(p, deleter); }
+    static void drain() { ebr_domain::instance().drain(); }
+};
+
+class hp_reclaim {
+public:
+    class guard {
+    private:
+        hp_domain::hp_record* rec;
+
+    public:
+        guard() : rec(hp_local_record()) {}
+        ~guard() {
+            for (int i = 0; i < HP_PER_THREAD; i++)
+                rec->hazard[i].store(nullptr, memory_order_release);
+        }
+
+        // Publishes the pointer in the slot and re-reads the source until both agree,
+        // so the node cannot have been retired and scanned in between.
+        template<class N>
+        N* protect(int slot, const atomic<N*>& src) {
+            N* p = src.load(memory_order_relaxed);
+            while (true) {
+                rec->hazard[slot].store(p, memory_order_seq_cst);
+                N* q = src.load(memory_order_acquire);
+                if (p == q)
+                    return p;
+                p = q;
+            }
+        }
+
+        void clear(int slot) {
+            rec->hazard[slot].store(nullptr, memory_order_release);
+        }
+    };
+
+    template<class N>
+    static void retire(N* n) {
+        hp_domain::instance().retire(n, [](void* p) { delete static_cast<N*>(p); });
+    }
+    static void retire(void* p, void (*deleter)(void*)) { hp_domain::instance().retire(p, deleter); }
+    static void drain() { hp_domain::instance().drain(); }
+};
+
+// Calls f.template operator()<Policy>() with the policy matching the runtime choice,
+// so a templated test or benchmark can be instantiated for every scheme.
+template<class F>
+auto with_reclaim(reclaim_type type, F&& f) {
+    switch (type) {
+        case RECLAIM_NONE:
+            return f.template operator()<no_reclaim>();
+        case RECLAIM_EBR:
+            return f.template operator()<ebr_reclaim>();
+        case RECLAIM_HP:
+        default:
+            return f.template operator()<hp_reclaim>();
+    }
+}
+
+const char* reclaim_name(reclaim_type type);
+
+#endif
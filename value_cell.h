@@ -0,0 +1,86 @@
+#ifndef VALUE_CELL_H
+#define VALUE_CELL_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+using namespace std;
+
+// Small trivially copyable payloads (int, pointers, small PODs) are kept in an atomic
+// inside the node: any thread may read them before it owns the node and nothing has to
+// be destroyed.
+template<class T>
+constexpr bool is_inline_value = is_trivially_copyable_v<T> && is_default_constructible_v<T> &&
+                                 sizeof(T) <= sizeof(void*);
+
+// Payload storage of a container node.
+// The general version holds a T constructed in place from the emplace arguments. Only the
+// thread that unlinked the node may take it out, which moves it and ends its lifetime,
+// so a popped value is never copied.
+template<class T, bool Inline = is_inline_value<T>>
+class value_cell {
+private:
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T* ptr() { return launder(reinterpret_cast<T*>(storage)); }
+
+public:
+    static constexpr bool is_inline = false;
+
+    template<class... Args>
+    void construct(Args&&... args) {
+        ::new (static_cast<void*>(storage)) T(forward<Args>(args)...);
+    }
+
+    void move_to(optional<T>& out) {
+        out.emplace(move(*ptr()));
+        ptr()->~T();
+    }
+
+    T take() {
+        T v(move(*ptr()));
+        ptr()->~T();
+        return v;
+    }
+
+    // For payloads still inside the container when it is destroyed
+    void destroy() { ptr()->~T(); }
+};
+
+template<class T>
+class value_cell<T, true> {
+private:
+    atomic<T> val;
+
+public:
+    static constexpr bool is_inline = true;
+
+    template<class... Args>
+    void construct(Args&&... args) {
+        val.store(T(forward<Args>(args)...), memory_order_relaxed);
+    }
+
+    // Safe before the node is owned, e.g. ahead of the CAS that unlinks it
+    T load() const { return val.load(memory_order_acquire); }
+
+    void move_to(optional<T>& out) { out.emplace(val.load(memory_order_acquire)); }
+
+    T take() { return val.load(memory_order_acquire); }
+
+    void destroy() {}
+};
+
+// Cell count of the rings of value cells (mpmc_ring, spsc_ring): the power of two at or
+// above n, at least 2, so that a position maps to its cell with a mask
+inline size_t round_up_pow2(size_t n) {
+    size_t size = 2;
+    while (size < n)
+        size *= 2;
+    return size;
+}
+
+#endif